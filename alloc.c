@@ -0,0 +1,83 @@
+#if defined(ALLOC_ACCOUNTING)
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+
+#include "alloc.h"
+
+// Heap allocation accounting for test builds (make check). malloc() and
+// friends are interposed for the whole process, libraries included, and
+// every allocation is counted for the thread making it. Code we cannot
+// change marks itself exempt: libxcb hands out events in malloc()ed
+// memory, and PAM frees whatever the conversation gives it, besides
+// allocating plenty inside its modules.
+//
+// The real allocator is glibc's, through its __libc_* entry points.
+
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t n, size_t size);
+extern void * __libc_realloc(void * p, size_t size);
+extern void * __libc_memalign(size_t align, size_t size);
+extern void __libc_free(void * p);
+
+static __thread int64_t count = 0;
+static __thread int exempt = 0;
+
+int64_t alloc_count(void) {
+    return count;
+}
+
+// nests, calls between alloc_exempt(1) and alloc_exempt(0) are not counted
+void alloc_exempt(const int on) {
+    exempt += on? 1: -1;
+}
+
+// xcb_poll_for_event(), events come in memory libxcb allocated, not ours
+xcb_generic_event_t * alloc_poll_event(xcb_connection_t * c) {
+    alloc_exempt(1);
+    xcb_generic_event_t * event = xcb_poll_for_event(c);
+    alloc_exempt(0);
+    return event;
+}
+
+#define counted(p) do { if ((p) && !exempt) count++; } while (0)
+
+void * malloc(size_t size) {
+    void * p = __libc_malloc(size);
+    counted(p);
+    return p;
+}
+
+void * calloc(size_t n, size_t size) {
+    void * p = __libc_calloc(n, size);
+    counted(p);
+    return p;
+}
+
+void * realloc(void * p, size_t size) {
+    void * np = __libc_realloc(p, size);
+    counted(np);
+    return np;
+}
+
+void * memalign(size_t align, size_t size) {
+    void * p = __libc_memalign(align, size);
+    counted(p);
+    return p;
+}
+
+void * aligned_alloc(size_t align, size_t size) {
+    return memalign(align, size);
+}
+
+int posix_memalign(void ** p, size_t align, size_t size) {
+    return (*p = memalign(align, size))? 0: ENOMEM;
+}
+
+void free(void * p) {
+    __libc_free(p);
+}
+
+#endif
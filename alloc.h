@@ -0,0 +1,24 @@
+#ifndef __ALLOC_H__
+#define __ALLOC_H__
+
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+// heap allocation accounting, in test builds only, see alloc.c
+#if defined(ALLOC_ACCOUNTING)
+#   include "metrics.h"
+
+int64_t alloc_count(void);
+void alloc_exempt(const int on);
+xcb_generic_event_t * alloc_poll_event(xcb_connection_t * c);
+
+// allocations made by this thread since a count taken earlier
+#   define alloc_metric(m, since) metric_time((m), alloc_count() - (since))
+#else
+#   define alloc_count() 0
+#   define alloc_exempt(on)
+#   define alloc_poll_event(c) xcb_poll_for_event(c)
+#   define alloc_metric(m, since) ((void)(since))
+#endif
+
+#endif
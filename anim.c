@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "anim.h"
+#include "timer.h"
+
+// A frame scheduler on top of one wtimer. The timer only runs while some
+// animation is still in progress, and concurrent animations just push the
+// end time further, so they all share the same frames.
+struct anim_sched_t {
+    wtimer_t * tick;
+    int64_t until;              // in us
+    anim_frame_cb cb;
+    void * data;
+};
+
+inline
+static int64_t timeval_us(const struct timeval * t) {
+    return (int64_t)t->tv_sec * 1000000 + t->tv_usec;
+}
+
+static void anim_tick_cb(wtimer_t * t, const struct timeval * now) {
+    anim_sched_t * as = wtimer_data(t);
+
+    (*as->cb)(as, now, as->data);
+
+    // last frame drawn, stop ticking till next kick
+    if (timeval_us(now) >= as->until) wtimer_suspend(t);
+}
+
+anim_sched_t * anim_sched_new(wtimer_list_t * tl, const uint64_t frame_us,
+        anim_frame_cb cb, void * data) {
+    anim_sched_t * as = calloc(1, sizeof(anim_sched_t));
+    as->cb   = cb;
+    as->data = data;
+    as->tick = wtimer_new(frame_us, anim_tick_cb,
+            WTIMER_TYPE_REPEAT, WTIMER_OP_INITSUSPEND);
+    wtimer_set_data(as->tick, as);
+    wtimer_add(tl, as->tick);
+    return as;
+}
+
+void anim_sched_free(anim_sched_t * as) {
+    free(as->tick);
+    free(as);
+}
+
+// some animation starts now and lasts for duration us
+void anim_sched_kick(anim_sched_t * as, const struct timeval * now,
+        const uint64_t duration) {
+    int64_t end = timeval_us(now) + duration;
+    if (end > as->until) as->until = end;
+
+    // already ticking, the new animation just joins the running frames
+    if (!wtimer_running(as->tick)) wtimer_rearm(as->tick, 0, NULL);
+}
+
+int anim_sched_active(const anim_sched_t * as) {
+    return wtimer_running(as->tick);
+}
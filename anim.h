@@ -0,0 +1,26 @@
+#ifndef __ANIM_H__
+#define __ANIM_H__
+
+#include <stdint.h>
+#include <sys/time.h>
+#include "timer.h"
+
+// frame interval of animations, one frame per vblank on a 60Hz output
+#if !defined ANIM_FRAME_US
+#   define ANIM_FRAME_US (1000 * 1000 / 60)
+#endif
+
+typedef struct anim_sched_t anim_sched_t;
+
+// called once per frame, however many animations are running
+typedef void (*anim_frame_cb)(anim_sched_t * as,
+        const struct timeval * now, void * data);
+
+anim_sched_t * anim_sched_new(wtimer_list_t * tl, const uint64_t frame_us,
+        anim_frame_cb cb, void * data);
+void anim_sched_free(anim_sched_t * as);
+void anim_sched_kick(anim_sched_t * as, const struct timeval * now,
+        const uint64_t duration);
+int anim_sched_active(const anim_sched_t * as);
+
+#endif
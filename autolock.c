@@ -0,0 +1,225 @@
+// fork() and friends are not in c99
+#define _XOPEN_SOURCE 500
+
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <xcb/xcb.h>
+#include <xcb/screensaver.h>
+
+#include "autolock.h"
+
+// --auto: lock when the X server says the user went idle. The server keeps
+// its idle timer for the screen saver anyway, so instead of polling it for
+// idle time we ask for MIT-SCREEN-SAVER notifications on every root, and
+// sleep in epoll without any timeout till one arrives. Nothing but the
+// connections is set up here, the lock screen is only loaded by the locker.
+//
+// --auto=SECONDS changes the server's saver timeout, for every client. The
+// old one is put back when the watcher is told to quit. Quit signals are
+// blocked but while we sleep, in epoll_pwait() or sigsuspend(), so one
+// can't slip in between checking for it and going to sleep.
+
+typedef struct {
+    const char * name;
+    xcb_connection_t * conn;
+    int event;                  // MIT-SCREEN-SAVER notify event
+    int changed;                // saver timeout set by us, saved is the old
+    xcb_get_screen_saver_reply_t saved;
+} watch_t;
+
+static watch_t * watches = NULL;
+static int nwatch = 0;
+
+static volatile sig_atomic_t quit_requested = 0;
+
+static void on_quit(int sig) {
+    quit_requested = 1;
+}
+
+// only there to wake sigsuspend() up
+static void on_child(int sig) {
+}
+
+// timeout: seconds of idle time before the server saver kicks in, 0 keeps
+// what the server has
+static int watch_init(watch_t * w, const int timeout) {
+    xcb_connection_t * c = xcb_connect(w->name, NULL);
+    xcb_screen_iterator_t iter;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "auto: unable to open xcb connection to %s\n",
+                w->name? w->name: "$DISPLAY");
+        exit(EXIT_FAILURE);
+    }
+    w->conn = c;
+
+    xcb_screensaver_query_version_reply_t * vr =
+        xcb_screensaver_query_version_reply(c,
+                xcb_screensaver_query_version(c, 1, 1), NULL);
+    if (!vr) {
+        fprintf(stderr, "auto: no MIT-SCREEN-SAVER on %s, not watched\n",
+                w->name? w->name: "$DISPLAY");
+        return 0;
+    }
+    free(vr);
+    w->event = xcb_get_extension_data(c, &xcb_screensaver_id)->first_event +
+        XCB_SCREENSAVER_NOTIFY;
+
+    xcb_get_screen_saver_reply_t * sr = xcb_get_screen_saver_reply(c,
+            xcb_get_screen_saver(c), NULL);
+    if (sr && timeout) {
+        w->saved   = *sr;
+        w->changed = 1;
+        xcb_set_screen_saver(c, timeout, sr->interval,
+                sr->prefer_blanking, sr->allow_exposures);
+    } else if (sr && !sr->timeout)
+        fprintf(stderr, "auto: screen saver is off on %s, try --auto=SECONDS "
+                "or xset s\n", w->name? w->name: "$DISPLAY");
+    free(sr);
+
+    for (iter = xcb_setup_roots_iterator(xcb_get_setup(c));
+         iter.rem; xcb_screen_next(&iter))
+        xcb_screensaver_select_input(c, iter.data->root,
+                XCB_SCREENSAVER_EVENT_NOTIFY_MASK);
+    xcb_flush(c);
+    return 1;
+}
+
+// drain pending events, returns non-zero if the saver turned on
+static int watch_idle(watch_t * w) {
+    xcb_generic_event_t * event;
+    int idle = 0;
+
+    while ((event = xcb_poll_for_event(w->conn))) {
+        if ((event->response_type & 0x7f) == w->event &&
+            ((xcb_screensaver_notify_event_t *)event)->state ==
+                XCB_SCREENSAVER_STATE_ON)
+            idle = 1;
+        free(event);
+    }
+    return idle;
+}
+
+// put back the saver timeouts we changed, then go
+static void watch_quit(void) {
+    watch_t * w = NULL;
+    for (w = watches; w < watches + nwatch; w++) {
+        if (!w->changed || xcb_connection_has_error(w->conn)) continue;
+        xcb_set_screen_saver(w->conn, w->saved.timeout, w->saved.interval,
+                w->saved.prefer_blanking, w->saved.allow_exposures);
+        xcb_flush(w->conn);
+        xcb_disconnect(w->conn);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// returns in the locker, every time the user went idle; the watcher itself
+// never returns
+void autolock_run(const char ** names, const int nd, const int timeout) {
+    struct epoll_event ev, evs[nd];
+    struct sigaction sa;
+    sigset_t blocked, orig;
+    int epoll_fd = epoll_create(1);
+    int i = 0, nev = 0, nlive = 0;
+    watch_t * w = NULL;
+
+    if (epoll_fd < 0) {
+        perror("epoll_create()");
+        exit(EXIT_FAILURE);
+    }
+
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGHUP);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &orig);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_quit;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    sa.sa_handler = on_child;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    nwatch  = nd;
+    watches = calloc(nd, sizeof(watch_t));
+    for (w = watches; w < watches + nwatch; w++) {
+        w->name = names[w - watches];
+        if (!watch_init(w, timeout)) continue;
+
+        ev.events   = EPOLLIN;
+        ev.data.ptr = w;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD,
+                    xcb_get_file_descriptor(w->conn), &ev)) {
+            perror("epoll_ctl()");
+            exit(EXIT_FAILURE);
+        }
+        nlive++;
+    }
+
+    while (nlive) {
+        int idle = 0, status = 0;
+
+        nev = epoll_pwait(epoll_fd, evs, nd, -1, &orig);
+        if (quit_requested) watch_quit();
+        if (nev < 0 && errno != EINTR) {
+            perror("epoll_pwait()");
+            exit(EXIT_FAILURE);
+        }
+
+        for (i = 0; i < nev; i++) {
+            w = evs[i].data.ptr;
+            idle |= watch_idle(w);
+            if (!xcb_connection_has_error(w->conn)) continue;
+
+            fprintf(stderr, "auto: lost connection to %s\n",
+                    w->name? w->name: "$DISPLAY");
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL,
+                    xcb_get_file_descriptor(w->conn), NULL);
+            nlive--;
+        }
+        if (!idle) continue;
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork()");
+            continue;
+        }
+
+        if (!pid) {
+            // the locker, on its own connections and signal handlers
+            for (w = watches; w < watches + nwatch; w++)
+                if (w->conn) close(xcb_get_file_descriptor(w->conn));
+            close(epoll_fd);
+            sa.sa_handler = SIG_DFL;
+            sigaction(SIGTERM, &sa, NULL);
+            sigaction(SIGINT, &sa, NULL);
+            sigaction(SIGHUP, &sa, NULL);
+            sigaction(SIGCHLD, &sa, NULL);
+            sigprocmask(SIG_SETMASK, &orig, NULL);
+            return;
+        }
+
+        // told to quit while locked: the locker stays, we go
+        while (!waitpid(pid, &status, WNOHANG)) {
+            if (quit_requested) watch_quit();
+            sigsuspend(&orig);
+        }
+
+        // whatever the saver did while we were locked is old news
+        for (w = watches; w < watches + nwatch; w++)
+            if (w->event) watch_idle(w);
+    }
+
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,6 @@
+#ifndef __AUTOLOCK_H__
+#define __AUTOLOCK_H__
+
+void autolock_run(const char ** names, const int nd, const int timeout);
+
+#endif
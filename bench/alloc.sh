@@ -0,0 +1,85 @@
+#!/bin/sh
+# Heap allocations, as counted by the test build from make check. Exits
+# non-zero if:
+#
+# - the input path allocates anything outside libxcb while typing, on
+#   backspace, Escape or a failed auth (allocs_key, allocs_loop)
+# - after warm-up, a render thread frame drawing keystrokes allocates more
+#   than bench/alloc-frame.max allows (allocs_frame). Cairo has allocations
+#   of its own so this can't be 0, but a surface or context set up per
+#   repaint goes well over it.
+#
+# Metrics start over at each dump, the warm-up round has one of its own.
+# allocs_render is shown for reference.
+#
+# Needs Xvfb and xdotool.
+#
+#   bench/alloc.sh
+
+DPY=:56
+WSLOCK=${WSLOCK:-./wslock-alloc}
+SNAPSHOT=$(dirname $0)/alloc-frame.max
+out=$(mktemp)
+
+Xvfb $DPY -screen 0 1920x1080x24 >/dev/null 2>&1 &
+XVFB=$!
+trap 'kill $XVFB 2>/dev/null; rm -f $out' EXIT
+sleep 1
+
+WSLOCK_METRICS=$out WSLOCK_METRICS_RESET=1 $WSLOCK $DPY 2>/dev/null &
+supervisor=$!
+sleep 2
+
+key() {
+    DISPLAY=$DPY xdotool key "$@"
+    sleep 0.2
+}
+
+round() {
+    key a b c d
+    key BackSpace BackSpace
+    key Escape
+    # never the password, PAM takes its time to say no
+    key w r o n g Return
+    sleep 4
+}
+
+dump() {
+    pkill -USR1 -n -f "wslock.*$DPY"
+    sleep 0.5
+}
+
+# warm-up, then the same again three times
+round
+dump
+for i in $(seq 3); do round; done
+dump
+kill $supervisor
+pkill -f "wslock.*$DPY"
+
+cat $out
+# two dumps, the first one is the warm-up
+awk -v snapshot=$SNAPSHOT '
+    $1 == "metric" { ndump++ }
+    $1 == "allocs_key" || $1 == "allocs_loop" {
+        if (!($1 in input) || $7 > input[$1]) input[$1] = $7
+    }
+    $1 == "allocs_frame" && ndump == 2 { frame = $7; nframe = $2 }
+    END {
+        if (input["allocs_key"] == "") { print "no keystroke measured"; exit 1 }
+        for (m in input)
+            if (input[m] > 0) { print m ": up to " input[m] " allocations"; bad = 1 }
+        if (!bad) print "input path allocation free"
+
+        if (!nframe) { print "no keystroke frame measured after warm-up"; exit 1 }
+        while ((getline line < snapshot) > 0)
+            if (line !~ /^#/) max = line
+        if (max == "") { print "no limit in " snapshot; exit 1 }
+        if (frame > max) {
+            print "keystroke frames: up to " frame " allocations, " \
+                snapshot " allows " max
+            exit 1
+        }
+        if (bad) exit 1
+        print "keystroke frames: up to " frame " allocations, " max " allowed"
+    }' $out
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Time from a screen size change to the lock window covering the new size,
+# as seen by wslock itself (hotplug_covered metric). Xephyr's RandR is used
+# to play monitor docking and undocking, and rotating to portrait.
+#
+# Needs Xephyr and xrandr, and an X display to run Xephyr on.
+#
+#   bench/hotplug.sh [rounds, default 20]
+
+ROUNDS=${1:-20}
+DPY=:58
+WSLOCK=${WSLOCK:-./wslock}
+out=$(mktemp)
+
+Xephyr $DPY -resizeable -screen 1280x720 >/dev/null 2>&1 &
+XEPHYR=$!
+trap 'kill $XEPHYR 2>/dev/null; rm -f $out' EXIT
+sleep 1
+
+WSLOCK_METRICS=$out $WSLOCK $DPY &
+pid=$!
+sleep 1
+
+for i in $(seq $ROUNDS); do
+    xrandr -d $DPY -s 1920x1080 >/dev/null 2>&1
+    sleep 0.2
+    xrandr -d $DPY -s 1280x720 >/dev/null 2>&1
+    sleep 0.2
+    # portrait, RandR reports the size unrotated
+    xrandr -d $DPY -o left >/dev/null 2>&1
+    sleep 0.2
+    xrandr -d $DPY -o normal >/dev/null 2>&1
+    sleep 0.2
+done
+
+kill -USR1 $pid
+sleep 0.5
+# supervisor first, or it would just relock
+kill $pid
+pkill -f "wslock.*$DPY"
+cat $out
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Keypress latency of wslock under memory pressure, plain, with --resident
+# and with --resident --priority. wslock and a stress-ng memory hog share
+# one memory limited cgroup, so the locker's pages get evicted between
+# keystrokes. Ends with a key_latency summary of the three runs, in us.
+#
+# Needs Xvfb, xdotool, stress-ng and a systemd user session.
+#
+#   bench/keypress-latency.sh [memory limit, default 256M]
+
+LIMIT=${1:-256M}
+DPY=:57
+WSLOCK=${WSLOCK:-./wslock}
+
+Xvfb $DPY -screen 0 1920x1080x24 >/dev/null 2>&1 &
+XVFB=$!
+SUMMARY=$(mktemp)
+trap 'kill $XVFB 2>/dev/null; rm -f $SUMMARY' EXIT
+sleep 1
+
+run() {
+    out=$(mktemp)
+    systemd-run --user --scope -q -p MemoryMax=$LIMIT -p MemorySwapMax=infinity \
+        sh -c "stress-ng -q --vm 2 --vm-bytes 95% --vm-keep & \
+               WSLOCK_METRICS=$out exec $WSLOCK $* $DPY" &
+    sleep 3
+    # the locker, not its supervisor
+    pid=$(pgrep -n -f "wslock.* $DPY")
+
+    # a keystroke every 2s, plenty of time for the pages to go away
+    for i in $(seq 20); do
+        DISPLAY=$DPY xdotool key a
+        sleep 2
+    done
+
+    kill -USR1 $pid
+    sleep 1
+    # supervisor first, or it would just relock
+    pkill -o -f "wslock.* $DPY"
+    kill $pid
+    pkill -f "stress-ng.*--vm-keep"
+    wait 2>/dev/null
+
+    echo "== wslock $*"
+    cat $out
+    awk -v run="${*:-plain}" '$1 == "key_latency" {
+            printf "%-22s %8s %8s %8s %8s\n", run, $2, $5, $6, $7
+        }' $out >> $SUMMARY
+    rm -f $out
+}
+
+run
+run --resident
+run --resident --priority
+
+echo "== key_latency"
+printf "%-22s %8s %8s %8s %8s\n" run count p50 p99 max
+cat $SUMMARY
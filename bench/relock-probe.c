@@ -0,0 +1,115 @@
+// Kills the locker, then times how long the screen stays uncovered and
+// ungrabbed, from outside wslock. Prints the gap in us.
+//
+//   cc -std=c99 -o relock-probe bench/relock-probe.c
+//      $(pkg-config --cflags --libs xcb)
+//   relock-probe DISPLAY LOCKER_PID
+//
+// Covered: the topmost viewable child of the first root is a window that
+// was not viewable when the locker was killed, the supervisor's cover.
+// Grabbed: a keyboard grab of our own fails with AlreadyGrabbed. Our grab
+// only gets through while nobody holds one, and is let go at once, so it
+// costs the supervisor one grab retry at worst. Polling adds a few round
+// trips, the gap printed is an upper bound.
+
+// kill() and clock_gettime() are not in c99
+#define _XOPEN_SOURCE 500
+#define _POSIX_C_SOURCE 199309L
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// viewable children of root, top first, returns how many were stored
+static int viewable(xcb_connection_t * c, const xcb_window_t root,
+        xcb_window_t * out, const int max) {
+    xcb_query_tree_reply_t * r = xcb_query_tree_reply(c,
+            xcb_query_tree(c, root), NULL);
+    int i = 0, n = 0;
+
+    if (!r) return 0;
+    xcb_window_t * w = xcb_query_tree_children(r);
+    for (i = xcb_query_tree_children_length(r) - 1; i >= 0 && n < max; i--) {
+        xcb_get_window_attributes_reply_t * a =
+            xcb_get_window_attributes_reply(c,
+                    xcb_get_window_attributes(c, w[i]), NULL);
+        if (a && a->map_state == XCB_MAP_STATE_VIEWABLE) out[n++] = w[i];
+        free(a);
+    }
+    free(r);
+    return n;
+}
+
+// the top window is one mapped since the kill
+static int covered(xcb_connection_t * c, const xcb_window_t root,
+        const xcb_window_t * before, const int nbefore) {
+    xcb_window_t top = XCB_NONE;
+    int i = 0;
+
+    if (!viewable(c, root, &top, 1)) return 0;
+    for (i = 0; i < nbefore; i++)
+        if (before[i] == top) return 0;
+    return 1;
+}
+
+static int grabbed(xcb_connection_t * c, const xcb_window_t root) {
+    xcb_grab_keyboard_reply_t * r = xcb_grab_keyboard_reply(c,
+            xcb_grab_keyboard(c, 1, root, XCB_CURRENT_TIME,
+                XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC), NULL);
+    int status = r? r->status: XCB_GRAB_STATUS_NOT_VIEWABLE;
+
+    free(r);
+    if (status == XCB_GRAB_STATUS_SUCCESS) {
+        xcb_ungrab_keyboard(c, XCB_CURRENT_TIME);
+        xcb_flush(c);
+    }
+    return status == XCB_GRAB_STATUS_ALREADY_GRABBED;
+}
+
+int main(const int argc, const char * argv[]) {
+    xcb_connection_t * c = NULL;
+    xcb_window_t root = XCB_NONE, before[1024];
+    int64_t killed = 0, timeout = 0;
+    int nbefore = 0;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: relock-probe DISPLAY LOCKER_PID\n");
+        return EXIT_FAILURE;
+    }
+    c = xcb_connect(argv[1], NULL);
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "unable to open xcb connection to %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    root    = xcb_setup_roots_iterator(xcb_get_setup(c)).data->root;
+    nbefore = viewable(c, root, before, 1024);
+
+    killed  = now_us();
+    timeout = killed + 5 * 1000 * 1000;
+    if (kill(atoi(argv[2]), SIGKILL)) {
+        perror("kill()");
+        return EXIT_FAILURE;
+    }
+
+    while (!covered(c, root, before, nbefore))
+        if (now_us() > timeout) goto timed_out;
+    while (!grabbed(c, root))
+        if (now_us() > timeout) goto timed_out;
+
+    printf("%lld\n", (long long)(now_us() - killed));
+    xcb_disconnect(c);
+    return EXIT_SUCCESS;
+
+timed_out:
+    fprintf(stderr, "not relocked within 5s\n");
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Kill the locker over and over, and check the screen was always covered and
+# grabbed again within one frame. The gap is timed from outside, by
+# bench/relock-probe.c, from the kill to the supervisor's cover on top and
+# a grab held. Exits non-zero if it ever took longer.
+#
+# Needs Xvfb, a C compiler and the xcb headers.
+#
+#   bench/relock.sh [rounds, default 20]
+
+ROUNDS=${1:-20}
+FRAME_US=16667
+DPY=:59
+WSLOCK=${WSLOCK:-./wslock}
+out=$(mktemp)
+gaps=$(mktemp)
+probe=$(mktemp)
+
+cc -std=c99 -o $probe $(dirname $0)/relock-probe.c \
+    $(pkg-config --cflags --libs xcb) || exit 1
+
+Xvfb $DPY -screen 0 1920x1080x24 >/dev/null 2>&1 &
+XVFB=$!
+trap 'kill $XVFB 2>/dev/null; rm -f $out $gaps $probe' EXIT
+sleep 1
+
+WSLOCK_METRICS=$out $WSLOCK $DPY 2>/dev/null &
+supervisor=$!
+
+for i in $(seq $ROUNDS); do
+    # sleep past the supervisor's restart backoff
+    sleep 1.5
+    $probe $DPY $(pgrep -P $supervisor) >> $gaps
+done
+sleep 1.5
+
+kill -USR1 $supervisor
+sleep 0.5
+pkill -P $supervisor
+kill $supervisor
+
+# relock_gap is the supervisor's part only, from reaping the locker
+cat $out
+sort -n $gaps | awk -v frame=$FRAME_US -v rounds=$ROUNDS '{
+        gap[n++] = $1
+    }
+    END {
+        if (n < rounds)          { print n "/" rounds " relocks seen"; exit 1 }
+        print "kill to covered and grabbed, us: p50 " gap[int(n / 2)] \
+            ", max " gap[n - 1]
+        if (gap[n - 1] > frame)  { print "relock took " gap[n - 1] "us"; exit 1 }
+        print n " relocks, all within one frame"
+    }'
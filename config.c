@@ -0,0 +1,402 @@
+// st_mtim and mkdir() are not in c99
+#define _XOPEN_SOURCE 700
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fontconfig/fontconfig.h>
+
+#include "config.h"
+#include "lock_screen.h"
+
+// The theme config is parsed, and the layout of each screen size resolved,
+// only when the config file, or the font file it resolves to, changes. The result is kept in the XDG cache as
+// a render plan which we just mmap() on the next start:
+//
+//   plan_header_t | layout_t[nlayout] | plan_point_t[npoint]
+//                 | plan_glyph_t[nglyph]
+
+#define PLAN_MAGIC   "WSRP"
+#define PLAN_VERSION 4
+
+// the font file cached glyph indices are good for
+typedef struct {
+    char file[256];             // empty if fontconfig found none
+    int32_t index, pad;         // face in the file
+    uint64_t size;
+    int64_t mtime_sec, mtime_nsec;
+} font_stamp_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    // stamp of the config file the plan was made from, all 0 for none
+    uint64_t cfg_ino, cfg_size;
+    int64_t  cfg_mtime_sec, cfg_mtime_nsec;
+    theme_t defaults;           // compiled in defaults it was made with
+    theme_t theme;
+    font_stamp_t font;          // what theme.font resolved to
+    uint32_t nlayout, npoint, nglyph, pad;
+} plan_header_t;
+
+struct plan_t {
+    plan_header_t * hdr;
+    size_t size;
+    int mapped;                 // hdr is mmap()ed cache, or malloc()ed
+    char * cache_path;          // NULL if there is no cache to write
+    theme_t theme;              // copy of hdr->theme, stays put when a
+                                // new layout replaces hdr
+};
+
+static const theme_t default_theme = {
+    .color_lock            = COLOR_LOCK,
+    .color_input           = COLOR_INPUT,
+    .color_input_fg        = COLOR_INPUT_FG,
+    .color_wrong           = COLOR_WRONG,
+    .color_wrong_fg        = COLOR_WRONG_FG,
+    .color_indicator_erase = COLOR_INDICATOR_ERASE,
+    .text_size             = TEXT_SIZE,
+    .stripe_width          = STRIPE_WIDTH,
+    .frame_budget          = FRAME_BUDGET,
+    .font                  = "sans-serif",
+};
+
+#define plan_layouts(h) ((layout_t *)((h) + 1))
+#define plan_points(h)  ((plan_point_t *)(plan_layouts(h) + (h)->nlayout))
+#define plan_glyphs_(h) ((plan_glyph_t *)(plan_points(h) + (h)->npoint))
+
+static size_t plan_size(const plan_header_t * h) {
+    return sizeof(plan_header_t) + h->nlayout * sizeof(layout_t)
+        + h->npoint * sizeof(plan_point_t) + h->nglyph * sizeof(plan_glyph_t);
+}
+
+// $XDG_<name>_HOME/wslock/<file>, or $HOME/<fallback>/wslock/<file>
+static char * xdg_path(const char * name, const char * fallback,
+        const char * file) {
+    char var[32], * path = NULL;
+    snprintf(var, sizeof(var), "XDG_%s_HOME", name);
+    const char * base = getenv(var), * home = getenv("HOME");
+    size_t len = 0;
+
+    if (base && *base) {
+        len  = strlen(base) + strlen(file) + 16;
+        path = malloc(len);
+        snprintf(path, len, "%s/wslock/%s", base, file);
+    } else if (home) {
+        len  = strlen(home) + strlen(fallback) + strlen(file) + 16;
+        path = malloc(len);
+        snprintf(path, len, "%s/%s/wslock/%s", home, fallback, file);
+    }
+    return path;
+}
+
+static int parse_color(const char * v, uint32_t * color) {
+    char * end = NULL;
+    if (*v == '#') v++;
+    else if (!strncmp(v, "0x", 2)) v += 2;
+    unsigned long c = strtoul(v, &end, 16);
+    if (end == v || *end || c > 0xffffff) return 1;
+    *color = c;
+    return 0;
+}
+
+static int parse_size(const char * v, uint32_t * size) {
+    char * end = NULL;
+    unsigned long s = strtoul(v, &end, 10);
+    if (end == v || *end || !s || s > 1000) return 1;
+    *size = s;
+    return 0;
+}
+
+// in us, up to a second
+static int parse_time(const char * v, uint32_t * us) {
+    char * end = NULL;
+    unsigned long t = strtoul(v, &end, 10);
+    if (end == v || *end || !t || t > 1000000) return 1;
+    *us = t;
+    return 0;
+}
+
+// key = value per line, # for comments. Bad lines are only warned about.
+static void parse_config(FILE * f, const char * path, theme_t * t) {
+    static const struct {
+        const char * key;
+        size_t off;
+        int (*parse)(const char *, uint32_t *);
+    } keys[] = {
+#define KEY(k, p) { #k, offsetof(theme_t, k), p }
+        KEY(color_lock,            parse_color),
+        KEY(color_input,           parse_color),
+        KEY(color_input_fg,        parse_color),
+        KEY(color_wrong,           parse_color),
+        KEY(color_wrong_fg,        parse_color),
+        KEY(color_indicator_erase, parse_color),
+        KEY(text_size,             parse_size),
+        KEY(stripe_width,          parse_size),
+        KEY(frame_budget,          parse_time),
+#undef KEY
+    };
+    char line[256];
+    int lineno = 0, i = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char * k = line, * v = NULL, * e = NULL;
+        while (isspace((unsigned char)*k)) k++;
+        if (!*k || *k == '#') continue;
+
+        if (!(v = strchr(k, '='))) goto bad_line;
+        for (e = v; e > k && isspace((unsigned char)e[-1]); e--) ;
+        *e = 0;
+        for (v++; isspace((unsigned char)*v); v++) ;
+        for (e = v + strlen(v); e > v && isspace((unsigned char)e[-1]); e--) ;
+        *e = 0;
+
+        if (!strcmp(k, "font")) {
+            snprintf(t->font, sizeof(t->font), "%s", v);
+            continue;
+        }
+        for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+            if (strcmp(k, keys[i].key)) continue;
+            if ((*keys[i].parse)(v, (uint32_t *)((char *)t + keys[i].off)))
+                goto bad_line;
+            break;
+        }
+        if (i < sizeof(keys) / sizeof(keys[0])) continue;
+
+bad_line:
+        fprintf(stderr, "%s:%d: ignoring bad config line\n", path, lineno);
+    }
+}
+
+// make the directory of path, and its parent, if missing
+static void make_dirs(const char * path) {
+    char * dir = strdup(path), * s = strrchr(dir, '/');
+    if (s) {
+        *s = 0;
+        if (mkdir(dir, 0700) && (s = strrchr(dir, '/'))) {
+            *s = 0;
+            mkdir(dir, 0700);
+            *s = '/';
+            mkdir(dir, 0700);
+        }
+    }
+    free(dir);
+}
+
+// the face cairo's toy font API picks for font, as lock_screen.c selects it
+static void font_stamp(const char * font, font_stamp_t * fs) {
+    FcPattern * pat = FcPatternCreate(), * match = NULL;
+    FcChar8 * file = NULL;
+    FcResult res;
+    struct stat st;
+    int index = 0;
+
+    memset(fs, 0, sizeof(*fs));
+    FcPatternAddString(pat, FC_FAMILY, (const FcChar8 *)font);
+    FcPatternAddInteger(pat, FC_SLANT, FC_SLANT_ROMAN);
+    FcPatternAddInteger(pat, FC_WEIGHT, FC_WEIGHT_BOLD);
+    FcConfigSubstitute(NULL, pat, FcMatchPattern);
+    FcDefaultSubstitute(pat);
+
+    if ((match = FcFontMatch(NULL, pat, &res)) &&
+        FcPatternGetString(match, FC_FILE, 0, &file) == FcResultMatch) {
+        snprintf(fs->file, sizeof(fs->file), "%s", (const char *)file);
+        if (FcPatternGetInteger(match, FC_INDEX, 0, &index) == FcResultMatch)
+            fs->index = index;
+        if (!stat(fs->file, &st)) {
+            fs->size       = st.st_size;
+            fs->mtime_sec  = st.st_mtim.tv_sec;
+            fs->mtime_nsec = st.st_mtim.tv_nsec;
+        }
+    }
+    if (match) FcPatternDestroy(match);
+    FcPatternDestroy(pat);
+}
+
+// map the cached plan, NULL if there is none or it is not usable
+static plan_header_t * map_plan(const char * path, size_t * size) {
+    struct stat st;
+    plan_header_t * h = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    if (!fstat(fd, &st) && st.st_size >= sizeof(plan_header_t)) {
+        h = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (h == MAP_FAILED) h = NULL;
+    }
+    close(fd);
+
+    if (h && (memcmp(h->magic, PLAN_MAGIC, 4) ||
+              h->version != PLAN_VERSION || plan_size(h) != st.st_size)) {
+        munmap(h, st.st_size);
+        h = NULL;
+    }
+    *size = h? st.st_size: 0;
+    return h;
+}
+
+// write the plan to cache and map it back, keep it in memory if we can't
+static void store_plan(plan_t * p, plan_header_t * h) {
+    size_t size = plan_size(h);
+    size_t len  = strlen(p->cache_path) + 16;
+    char * tmp  = malloc(len);
+    int fd = -1, ok = 0;
+
+    snprintf(tmp, len, "%s.%d", p->cache_path, (int)getpid());
+    make_dirs(p->cache_path);
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0) {
+        ok = write(fd, h, size) == size;
+        ok = !close(fd) && ok && !rename(tmp, p->cache_path);
+        if (!ok) unlink(tmp);
+    }
+    free(tmp);
+
+    if (p->hdr && p->mapped) munmap(p->hdr, p->size);
+    else if (p->hdr && p->hdr != h) free(p->hdr);
+
+    if (ok && (p->hdr = map_plan(p->cache_path, &p->size))) {
+        p->mapped = 1;
+        free(h);
+    } else {
+        p->hdr    = h;
+        p->size   = size;
+        p->mapped = 0;
+    }
+}
+
+plan_t * plan_load(void) {
+    plan_t * p = calloc(1, sizeof(plan_t));
+    char * cfg_path = xdg_path("CONFIG", ".config", "config");
+    font_stamp_t font;
+    struct stat st;
+
+    p->cache_path = xdg_path("CACHE", ".cache", "plan");
+
+    memset(&st, 0, sizeof(st));
+    if (cfg_path && stat(cfg_path, &st)) memset(&st, 0, sizeof(st));
+
+    // fast path, config not changed since the plan was made, and its font
+    // still the same face in the same file
+    if (p->cache_path && (p->hdr = map_plan(p->cache_path, &p->size))) {
+        plan_header_t * h = p->hdr;
+        p->mapped = 1;
+        if (h->cfg_ino == st.st_ino && h->cfg_size == st.st_size &&
+            h->cfg_mtime_sec  == st.st_mtim.tv_sec &&
+            h->cfg_mtime_nsec == st.st_mtim.tv_nsec &&
+            !memcmp(&h->defaults, &default_theme, sizeof(theme_t))) {
+            font_stamp(h->theme.font, &font);
+            if (!memcmp(&h->font, &font, sizeof(font_stamp_t))) {
+                p->theme = h->theme;
+                free(cfg_path);
+                return p;
+            }
+        }
+        munmap(p->hdr, p->size);
+        p->hdr    = NULL;
+        p->mapped = 0;
+    }
+
+    // parse config, layouts are added as screens ask for them
+    plan_header_t * h = calloc(1, sizeof(plan_header_t));
+    memcpy(h->magic, PLAN_MAGIC, 4);
+    h->version        = PLAN_VERSION;
+    h->cfg_ino        = st.st_ino;
+    h->cfg_size       = st.st_size;
+    h->cfg_mtime_sec  = st.st_mtim.tv_sec;
+    h->cfg_mtime_nsec = st.st_mtim.tv_nsec;
+    h->defaults       = default_theme;
+    h->theme          = default_theme;
+
+    FILE * f = NULL;
+    if (st.st_ino && (f = fopen(cfg_path, "r"))) {
+        parse_config(f, cfg_path, &h->theme);
+        fclose(f);
+    }
+    free(cfg_path);
+    p->theme = h->theme;
+    font_stamp(h->theme.font, &h->font);
+
+    if (p->cache_path) {
+        store_plan(p, h);
+    } else {
+        p->hdr  = h;
+        p->size = plan_size(h);
+    }
+    return p;
+}
+
+void plan_free(plan_t * p) {
+    if (p->mapped) munmap(p->hdr, p->size);
+    else free(p->hdr);
+    free(p->cache_path);
+    free(p);
+}
+
+// valid for the plan's whole life, unlike layouts
+const theme_t * plan_theme(const plan_t * p) {
+    return &p->theme;
+}
+
+const layout_t * plan_layout(const plan_t * p,
+        const uint16_t width, const uint16_t height) {
+    const layout_t * l = plan_layouts(p->hdr);
+    int i = 0;
+    for (i = 0; i < p->hdr->nlayout; i++)
+        if (l[i].width == width && l[i].height == height) return l + i;
+    return NULL;
+}
+
+const plan_point_t * plan_stripes(const plan_t * p, const layout_t * l) {
+    return plan_points(p->hdr) + l->stripe_off;
+}
+
+const plan_glyph_t * plan_glyphs(const plan_t * p, const layout_t * l) {
+    return plan_glyphs_(p->hdr) + l->glyph_off;
+}
+
+// a new screen size, resolved by the caller. Offsets in l are filled here.
+// The plan is reallocated, or mapped again: every layout_t, plan_point_t and
+// plan_glyph_t pointer got from it before is gone, only the returned layout
+// and the theme are valid.
+const layout_t * plan_add_layout(plan_t * p, const layout_t * l,
+        const plan_point_t * pts, const plan_glyph_t * glyphs) {
+    const plan_header_t * o = p->hdr;
+    uint32_t npts = l->nstripe * PLAN_STRIPE_POINTS;
+    plan_header_t * h = malloc(plan_size(o) + sizeof(layout_t)
+            + npts * sizeof(plan_point_t) + l->nglyph * sizeof(plan_glyph_t));
+
+    memcpy(h, o, sizeof(plan_header_t));
+    h->nlayout++;
+    h->npoint += npts;
+    h->nglyph += l->nglyph;
+
+    memcpy(plan_layouts(h), plan_layouts(o), o->nlayout * sizeof(layout_t));
+    memcpy(plan_points(h), plan_points(o), o->npoint * sizeof(plan_point_t));
+    memcpy(plan_points(h) + o->npoint, pts, npts * sizeof(plan_point_t));
+    memcpy(plan_glyphs_(h), plan_glyphs_(o), o->nglyph * sizeof(plan_glyph_t));
+    memcpy(plan_glyphs_(h) + o->nglyph, glyphs,
+            l->nglyph * sizeof(plan_glyph_t));
+
+    layout_t * nl = plan_layouts(h) + o->nlayout;
+    *nl = *l;
+    nl->stripe_off = o->npoint;
+    nl->glyph_off  = o->nglyph;
+
+    if (p->cache_path) {
+        store_plan(p, h);
+    } else {
+        free(p->hdr);
+        p->hdr  = h;
+        p->size = plan_size(h);
+    }
+    return plan_layout(p, l->width, l->height);
+}
@@ -0,0 +1,49 @@
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include <stdint.h>
+
+// everything a theme can change, compiled in defaults are in lock_screen.h
+typedef struct {
+    uint32_t color_lock;
+    uint32_t color_input;
+    uint32_t color_input_fg;
+    uint32_t color_wrong;
+    uint32_t color_wrong_fg;
+    uint32_t color_indicator_erase;
+    uint32_t text_size;
+    uint32_t stripe_width;
+    uint32_t frame_budget;      // in us
+    char font[64];
+} theme_t;
+
+typedef struct { float x, y; } plan_point_t;
+typedef struct { uint32_t index; float x, y; } plan_glyph_t;
+
+// resolved layout of one screen size
+typedef struct {
+    uint16_t width, height;
+    float ring_x, ring_y, ring_r, ring_w;   // indicator ring
+    float ind_x, ind_y, ind_w, ind_h;       // and its bounding box
+    float text_x, text_y, text_w, text_h;   // box behind "ACCESS DENIED"
+    float status[3][4];                     // x, y, w, h of status items
+    uint32_t stripe_off, nstripe;           // PLAN_STRIPE_POINTS each
+    uint32_t glyph_off, nglyph;             // "ACCESS DENIED" glyphs
+} layout_t;
+
+#define PLAN_STRIPE_POINTS 6
+
+typedef struct plan_t plan_t;
+
+plan_t * plan_load(void);
+void plan_free(plan_t * p);
+const theme_t * plan_theme(const plan_t * p);
+const layout_t * plan_layout(const plan_t * p,
+        const uint16_t width, const uint16_t height);
+const plan_point_t * plan_stripes(const plan_t * p, const layout_t * l);
+const plan_glyph_t * plan_glyphs(const plan_t * p, const layout_t * l);
+// invalidates every layout and point of the plan got before
+const layout_t * plan_add_layout(plan_t * p, const layout_t * l,
+        const plan_point_t * pts, const plan_glyph_t * glyphs);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#include "fade.h"
+
+// A fade to a new frame, done by the X server. The new frame is rendered
+// once into a pixmap, then composited over whatever the window shows with
+// a solid alpha mask, one step of a precomputed ramp per frame. Each step
+// blends over the one before, the ramp is chosen so the steps add up to an
+// eased curve, and nothing but the new frame needs to be kept around.
+
+struct fade_t {
+    xcb_connection_t * conn;
+    xcb_render_picture_t dst;               // the window
+    xcb_render_picture_t src;               // the new frame, while fading
+    xcb_render_picture_t ramp[FADE_FRAMES]; // solid alpha masks
+    xcb_render_pictformat_t format;
+    uint16_t width, height;
+    int step;                               // next step, FADE_FRAMES if idle
+};
+
+static xcb_render_pictformat_t visual_format(xcb_connection_t * c,
+        const xcb_visualid_t visual) {
+    xcb_render_query_pict_formats_reply_t * r =
+        xcb_render_query_pict_formats_reply(c,
+                xcb_render_query_pict_formats(c), NULL);
+    xcb_render_pictscreen_iterator_t si;
+    xcb_render_pictdepth_iterator_t di;
+    xcb_render_pictvisual_iterator_t vi;
+    xcb_render_pictformat_t format = 0;
+
+    if (!r) return 0;
+    for (si = xcb_render_query_pict_formats_screens_iterator(r);
+         si.rem && !format; xcb_render_pictscreen_next(&si)) {
+        for (di = xcb_render_pictscreen_depths_iterator(si.data);
+             di.rem && !format; xcb_render_pictdepth_next(&di)) {
+            for (vi = xcb_render_pictdepth_visuals_iterator(di.data);
+                 vi.rem; xcb_render_pictvisual_next(&vi)) {
+                if (vi.data->visual != visual) continue;
+                format = vi.data->format;
+                break;
+            }
+        }
+    }
+    free(r);
+    return format;
+}
+
+// alpha of each step, blended over the last, so that after step i the new
+// frame is smoothstep(i / FADE_FRAMES) of the picture
+static void ramp_init(fade_t * f) {
+    double done = 0, a = 0, t = 0;
+    int i = 0;
+
+    for (i = 0; i < FADE_FRAMES; i++) {
+        t = (i + 1.0) / FADE_FRAMES;
+        a = t * t * (3 - 2 * t);
+        xcb_render_color_t mask = {
+            0, 0, 0, (uint16_t)((a - done) / (1 - done) * 0xffff + 0.5),
+        };
+        f->ramp[i] = xcb_generate_id(f->conn);
+        xcb_render_create_solid_fill(f->conn, f->ramp[i], mask);
+        done = a;
+    }
+}
+
+// NULL without RENDER, windows just switch frames then
+fade_t * fade_new(xcb_connection_t * c, xcb_screen_t * s, xcb_window_t w) {
+    xcb_render_query_version_reply_t * r = xcb_render_query_version_reply(c,
+            xcb_render_query_version(c, XCB_RENDER_MAJOR_VERSION,
+                XCB_RENDER_MINOR_VERSION), NULL);
+    xcb_render_pictformat_t format = 0;
+
+    if (!r) return NULL;
+    free(r);
+    if (!(format = visual_format(c, s->root_visual))) return NULL;
+
+    fade_t * f = calloc(1, sizeof(fade_t));
+    f->conn   = c;
+    f->format = format;
+    f->step   = FADE_FRAMES;
+    f->dst    = xcb_generate_id(c);
+    xcb_render_create_picture(c, f->dst, w, format, 0, NULL);
+    ramp_init(f);
+    return f;
+}
+
+void fade_free(fade_t * f) {
+    int i = 0;
+    if (!f) return;
+    if (fade_running(f)) xcb_render_free_picture(f->conn, f->src);
+    for (i = 0; i < FADE_FRAMES; i++)
+        xcb_render_free_picture(f->conn, f->ramp[i]);
+    xcb_render_free_picture(f->conn, f->dst);
+    free(f);
+}
+
+// fade from what the window shows now to the pixmap, which must not be
+// drawn on till the fade is done
+void fade_start(fade_t * f, const xcb_pixmap_t to, const uint16_t width,
+        const uint16_t height) {
+    fade_finish(f);
+    f->src = xcb_generate_id(f->conn);
+    xcb_render_create_picture(f->conn, f->src, to, f->format, 0, NULL);
+    f->width  = width;
+    f->height = height;
+    f->step   = 0;
+}
+
+static void fade_done(fade_t * f) {
+    xcb_render_free_picture(f->conn, f->src);
+    f->step = FADE_FRAMES;
+}
+
+// one frame of the fade, returns 0 once it's done
+int fade_step(fade_t * f) {
+    if (!fade_running(f)) return 0;
+    xcb_render_composite(f->conn, XCB_RENDER_PICT_OP_OVER,
+            f->src, f->ramp[f->step], f->dst,
+            0, 0, 0, 0, 0, 0, f->width, f->height);
+    if (++f->step < FADE_FRAMES) return 1;
+    fade_done(f);
+    return 0;
+}
+
+// skip to the end, something else is about to be drawn
+void fade_finish(fade_t * f) {
+    if (!fade_running(f)) return;
+    xcb_render_composite(f->conn, XCB_RENDER_PICT_OP_SRC,
+            f->src, XCB_RENDER_PICTURE_NONE, f->dst,
+            0, 0, 0, 0, 0, 0, f->width, f->height);
+    fade_done(f);
+}
+
+int fade_running(const fade_t * f) {
+    return f && f->step < FADE_FRAMES;
+}
@@ -0,0 +1,21 @@
+#ifndef __FADE_H__
+#define __FADE_H__
+
+#include <xcb/xcb.h>
+
+// frames a fade takes, at one step per animation frame
+#if !defined FADE_FRAMES
+#   define FADE_FRAMES 12
+#endif
+
+typedef struct fade_t fade_t;
+
+fade_t * fade_new(xcb_connection_t * c, xcb_screen_t * s, xcb_window_t w);
+void fade_free(fade_t * f);
+void fade_start(fade_t * f, const xcb_pixmap_t to, const uint16_t width,
+        const uint16_t height);
+int fade_step(fade_t * f);
+void fade_finish(fade_t * f);
+int fade_running(const fade_t * f);
+
+#endif
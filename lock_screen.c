@@ -1,15 +1,22 @@
 #include <xcb/xcb.h>
 #include <cairo/cairo.h>
 #include <cairo/cairo-xcb.h>
+#include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "lock_screen.h"
-#include "timer.h"
+#include "config.h"
 
 #define MIN(x, y) ((x) > (y)? (y): (x))
 
-extern wtimer_t * pass_wrong_timer;
+// not in c99
+#if !defined(M_PI)
+#   define M_PI 3.14159265358979323846
+#endif
 
 static xcb_visualtype_t * get_root_visualitype(xcb_screen_t * s) {
     xcb_depth_iterator_t depth_iter;
@@ -27,7 +34,17 @@ static xcb_visualtype_t * get_root_visualitype(xcb_screen_t * s) {
     return NULL;
 }
 
-static xcb_visualtype_t * visual_type = NULL;
+// cached visual_type, only looked up again when asked for another screen
+static xcb_screen_t * visual_screen = NULL;
+static xcb_visualtype_t * visual_cached = NULL;
+
+static xcb_visualtype_t * screen_visual(xcb_screen_t * s) {
+    if (s != visual_screen) {
+        visual_cached = get_root_visualitype(s);
+        visual_screen = s;
+    }
+    return visual_cached;
+}
 
 #define cairo_set_source_uint32(c, color) do { \
     cairo_set_source_rgb(c, \
@@ -36,29 +53,83 @@ static xcb_visualtype_t * visual_type = NULL;
             (((color) & 0x000000ff) >> 0)  / 255.0); \
 } while (0)
 
-static void draw_stripes(cairo_t * cc,
-        const uint16_t width, const uint16_t height,
-        const uint32_t fg,    const uint32_t bg,
-        const uint16_t space, const char * text) {
+#define cairo_set_source_uint32_alpha(c, color, a) do { \
+    cairo_set_source_rgba(c, \
+            (((color) & 0x00ff0000) >> 16) / 255.0, \
+            (((color) & 0x0000ff00) >> 8)  / 255.0, \
+            (((color) & 0x000000ff) >> 0)  / 255.0, (a)); \
+} while (0)
 
-    cairo_set_source_uint32(cc, fg);
-    cairo_set_font_size(cc, TEXT_SIZE);
-    cairo_select_font_face(cc, "sans-serif",
+// theme and per screen size layouts, see config.c
+static plan_t * plan = NULL;
+
+void lock_screen_init(plan_t * p) {
+    plan = p;
+}
+
+#define ERROR_TEXT "ACCESS DENIED"
+
+static void select_font(cairo_t * cc, const theme_t * t, const double size) {
+    cairo_select_font_face(cc, t->font,
             CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(cc, size);
+}
+
+// resolve the layout of a screen size never seen before, and cache it
+static const layout_t * build_layout(const uint16_t width,
+        const uint16_t height) {
+    const theme_t * t = plan_theme(plan);
+    const uint16_t space = t->stripe_width;
+    layout_t l = { .width = width, .height = height };
+    int i = 0;
+
+    cairo_surface_t * cs = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 1, 1);
+    cairo_t * cc = cairo_create(cs);
+
+    // indicator ring, centered
+    l.ring_x = width  / 2;
+    l.ring_y = height / 2;
+    l.ring_r = t->text_size * 1.5;
+    l.ring_w = t->text_size / 4;
+    l.ind_w  = l.ind_h = 2 * (l.ring_r + l.ring_w);
+    l.ind_x  = (int)((width  - l.ind_w) / 2);
+    l.ind_y  = (int)((height - l.ind_h) / 2);
+
+    // status overlay: caps lock under the ring, keyboard layout at bottom
+    // left and battery at bottom right
+    const float sh = t->text_size * 0.75, sw = t->text_size * 6;
+    const float margin = t->text_size / 2;
+    float * r = l.status[0];
+    r[0] = (int)((width - sw) / 2);
+    r[1] = (int)(l.ind_y + l.ind_h + margin);
+    r = l.status[1];
+    r[0] = margin;
+    r[1] = (int)(height - margin - sh);
+    r = l.status[2];
+    r[0] = (int)(width - margin - sw);
+    r[1] = (int)(height - margin - sh);
+    for (i = 0; i < STATUS_ITEMS; i++) {
+        l.status[i][2] = sw;
+        l.status[i][3] = sh;
+    }
 
     // calculate text and stripe size
     uint16_t x = 0, y = 0, w = 0, h = 0;
     cairo_text_extents_t te;
-    cairo_text_extents(cc, text, &te);
+    select_font(cc, t, t->text_size);
+    cairo_text_extents(cc, ERROR_TEXT, &te);
 
     w = te.width + 3 * te.height;
     h = te.height * 3;
     x = (width  - w) / 2;
     y = (height - h) / 2;
 
-    // dwar the strip
-    int i = 0, nstripe = ((w + h) / space + 1) / 2;
-    for (i = 0; i < nstripe; i++) {
+    // the stripes, PLAN_STRIPE_POINTS points each, unused corners are
+    // repeated points
+    l.nstripe = ((w + h) / space + 1) / 2;
+    plan_point_t * pts = calloc(l.nstripe * PLAN_STRIPE_POINTS,
+            sizeof(plan_point_t)), * p = pts;
+    for (i = 0; i < l.nstripe; i++, p += PLAN_STRIPE_POINTS) {
         uint16_t x1 = space * (i * 2 + 1.5);
         uint16_t y1 = x1 > w? x1 - w: 0;
         uint16_t x2 = space * (i * 2 + 0.5);
@@ -68,108 +139,584 @@ static void draw_stripes(cairo_t * cc,
         uint16_t y4 = space * (i * 2 + 1.5);
         uint16_t x4 = y4 > h? y4 - h: 0;
 
-        cairo_move_to(cc, x + MIN(x1, w), y + y1);
-        if (y2 == 0 && y1 != 0) cairo_line_to(cc, x + w, y);
-        cairo_line_to(cc, x + MIN(x2, w), y + y2);
-        cairo_line_to(cc, x + x3, y + MIN(y3, h));
-        if (x3 == 0 && x4 != 0) cairo_line_to(cc, x, y + h);
-        cairo_line_to(cc, x + x4, y + MIN(y4, h));
+        p[0].x = x + MIN(x1, w); p[0].y = y + y1;
+        p[1] = p[0];
+        if (y2 == 0 && y1 != 0) { p[1].x = x + w; p[1].y = y; }
+        p[2].x = x + MIN(x2, w); p[2].y = y + y2;
+        p[3].x = x + x3;         p[3].y = y + MIN(y3, h);
+        p[4] = p[3];
+        if (x3 == 0 && x4 != 0) { p[4].x = x; p[4].y = y + h; }
+        p[5].x = x + x4;         p[5].y = y + MIN(y4, h);
+    }
+
+    // box behind the text, and where the glyphs go
+    l.text_w = te.width  + 2 * space;
+    l.text_h = te.height + 2 * space;
+    l.text_x = (int)((width  - l.text_w) / 2);
+    l.text_y = (int)((height - l.text_h) / 2);
+
+    cairo_glyph_t * cg = NULL;
+    int ng = 0;
+    cairo_scaled_font_text_to_glyphs(cairo_get_scaled_font(cc),
+            l.text_x + space - te.x_bearing, l.text_y + space - te.y_bearing,
+            ERROR_TEXT, -1, &cg, &ng, NULL, NULL, NULL);
+    l.nglyph = ng;
+    plan_glyph_t * glyphs = calloc(ng + 1, sizeof(plan_glyph_t));
+    for (i = 0; i < ng; i++) {
+        glyphs[i].index = cg[i].index;
+        glyphs[i].x     = cg[i].x;
+        glyphs[i].y     = cg[i].y;
+    }
+    cairo_glyph_free(cg);
+    cairo_destroy(cc);
+    cairo_surface_destroy(cs);
+
+    const layout_t * nl = plan_add_layout(plan, &l, pts, glyphs);
+    free(pts);
+    free(glyphs);
+    return nl;
+}
+
+static const layout_t * screen_layout(const uint16_t width,
+        const uint16_t height) {
+    const layout_t * l = plan_layout(plan, width, height);
+    return l? l: build_layout(width, height);
+}
+
+static void draw_stripes(cairo_t * cc, const layout_t * l,
+        const uint32_t fg) {
+    const plan_point_t * p = plan_stripes(plan, l);
+    int i = 0, j = 0;
+
+    cairo_set_source_uint32(cc, fg);
+    for (i = 0; i < l->nstripe; i++, p += PLAN_STRIPE_POINTS) {
+        cairo_move_to(cc, p[0].x, p[0].y);
+        for (j = 1; j < PLAN_STRIPE_POINTS; j++)
+            cairo_line_to(cc, p[j].x, p[j].y);
         cairo_close_path(cc);
     }
     cairo_fill(cc);
+}
+
+// "ACCESS DENIED" on its box
+static void draw_text(cairo_t * cc, const layout_t * l,
+        const uint32_t fg, const uint32_t bg) {
+    const theme_t * t = plan_theme(plan);
+    const plan_glyph_t * g = plan_glyphs(plan, l);
+    cairo_glyph_t cg[l->nglyph + 1];
+    int i = 0;
 
-    // draw the text
     cairo_set_source_uint32(cc, bg);
-    w = te.width  + 2 * space;
-    h = te.height + 2 * space;
-    x = (width  - w) / 2;
-    y = (height - h) / 2;
-    cairo_rectangle(cc, x, y, w, h);
+    cairo_rectangle(cc, l->text_x, l->text_y, l->text_w, l->text_h);
     cairo_fill(cc);
+
+    for (i = 0; i < l->nglyph; i++) {
+        cg[i].index = g[i].index;
+        cg[i].x     = g[i].x;
+        cg[i].y     = g[i].y;
+    }
     cairo_set_source_uint32(cc, fg);
-    cairo_move_to(cc, x + space - te.x_bearing, y + space - te.y_bearing);
-    cairo_show_text(cc, text);
-}
-
-void draw_input_box(cairo_t * cc,
-        const uint16_t width, const uint16_t height,
-        const uint32_t fg,    const uint32_t bg,
-        const uint32_t pad,   const int len) {
-    // U+25CF BLACK CIRCLE, UTF-8 encoding
-    static const char dot[] = {0xE2, 0x97, 0x8F, 0x00};
-    cairo_set_font_size(cc, TEXT_SIZE * 0.75);
-    cairo_select_font_face(cc, "sans-serif",
-            CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    select_font(cc, t, t->text_size);
+    cairo_show_glyphs(cc, cg, l->nglyph);
+}
 
-    cairo_text_extents_t te;
-    cairo_text_extents(cc, dot, &te);
+void indicator_reset(indicator_t * ind) {
+    memset(ind->lit, 0, sizeof(ind->lit));
+}
 
-    int show_len = MIN(len, PASS_SHOW_LEN);
-    // draw the outer box
-    uint16_t x = 0, y = 0, w = 0, h = 0;
-    w = te.width * show_len + pad * (show_len - 1) + te.height;
-    h = te.height * 2;
-    x = (width -  w) / 2;
-    y = (height - h) / 2;
+// light up a random segment, so the ring never tells how long the input is
+void indicator_hit(indicator_t * ind, const struct timeval * now,
+        const int erase) {
+    // xorshift32, seeded from the first keypress
+    uint32_t x = ind->seed? ind->seed: (uint32_t)now->tv_usec | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ind->seed = x;
 
-    cairo_set_source_uint32(cc, fg);
-    cairo_rectangle(cc, x, y, w, h);
-    cairo_set_line_width(cc, TEXT_SIZE / 10);
-    cairo_stroke(cc);
+    int i = x % INDICATOR_SEGMENTS;
+    ind->lit[i]   = (int64_t)now->tv_sec * 1000000 + now->tv_usec;
+    ind->erase[i] = erase;
+}
+
+// fade of segment i, 1 for just lit, 0 for faded out. Without fade,
+// segments stay fully lit, then go out at once.
+static double segment_alpha(const indicator_t * ind, const int i,
+        const int64_t now, const int fade) {
+    int64_t age = now - ind->lit[i];
+    if (!ind->lit[i] || age >= INDICATOR_FADE) return 0;
+    if (!fade) return 1;
+    return 1.0 - (double)age / INDICATOR_FADE;
+}
 
-    // draw text
+int indicator_active(const indicator_t * ind, const struct timeval * now) {
+    int64_t t = (int64_t)now->tv_sec * 1000000 + now->tv_usec;
     int i = 0;
-    w = te.width * show_len + pad * (show_len - 1);
-    h = te.height;
-    x = (width -  w) / 2;
-    y = (height - h) / 2;
-    for (i = 0; i < show_len; i++) {
-        cairo_move_to(cc,
-            x + i * (te.width + pad) - te.x_bearing, y - te.y_bearing);
-        cairo_show_text(cc, dot);
+    for (i = 0; i < INDICATOR_SEGMENTS; i++)
+        if (segment_alpha(ind, i, t, 1) > 0) return 1;
+    return 0;
+}
+
+// bit i set for every segment still showing
+unsigned indicator_lit(const indicator_t * ind, const struct timeval * now) {
+    int64_t t = (int64_t)now->tv_sec * 1000000 + now->tv_usec;
+    unsigned lit = 0;
+    int i = 0;
+    for (i = 0; i < INDICATOR_SEGMENTS; i++)
+        if (segment_alpha(ind, i, t, 1) > 0) lit |= 1u << i;
+    return lit;
+}
+
+static void draw_indicator(cairo_t * cc, const layout_t * l,
+        const uint32_t fg, const uint32_t erase, const int fade,
+        const int len, const indicator_t * ind, const struct timeval * now) {
+    const double seg = 2 * M_PI / INDICATOR_SEGMENTS;
+    const double gap = seg / 8;
+    int64_t t = (int64_t)now->tv_sec * 1000000 + now->tv_usec;
+    int i = 0;
+
+    cairo_set_line_width(cc, l->ring_w);
+
+    // dimmed ring, only while there is something typed
+    if (len) {
+        cairo_set_source_uint32_alpha(cc, fg, 0.25);
+        cairo_new_path(cc);
+        cairo_arc(cc, l->ring_x, l->ring_y, l->ring_r, 0, 2 * M_PI);
+        cairo_stroke(cc);
+    }
+
+    for (i = 0; i < INDICATOR_SEGMENTS; i++) {
+        double a = segment_alpha(ind, i, t, fade);
+        if (a <= 0) continue;
+        cairo_set_source_uint32_alpha(cc, ind->erase[i]? erase: fg, a);
+        cairo_new_path(cc);
+        cairo_arc(cc, l->ring_x, l->ring_y, l->ring_r,
+                i * seg + gap, (i + 1) * seg - gap);
+        cairo_stroke(cc);
     }
 }
 
-void lock_screen_input(xcb_connection_t * c, xcb_screen_t * s,
-        xcb_window_t w, const int len) {
-    // cached visual_type
-    if (!visual_type) visual_type = get_root_visualitype(s);
+// one status item, only its own region is touched
+static void draw_status_item(cairo_t * cc, const layout_t * l,
+        const int item, const uint32_t bg, const status_t * st) {
+    const theme_t * t = plan_theme(plan);
+    const float * r = l->status[item];
+    uint32_t fg = t->color_input_fg;
+    char text[48] = "";
 
-    cairo_surface_t * xcb_cs = cairo_xcb_surface_create(c, w, visual_type,
-            s->width_in_pixels, s->height_in_pixels);
-    cairo_t * xcb_cc = cairo_create(xcb_cs);
+    switch (1 << item) {
+        case STATUS_CAPS:
+            if (!st->caps_lock) break;
+            snprintf(text, sizeof(text), "CAPS LOCK");
+            fg = t->color_wrong_fg;
+            break;
+        case STATUS_LAYOUT:
+            snprintf(text, sizeof(text), "%s", st->layout);
+            break;
+        case STATUS_BATTERY:
+            if (st->battery < 0) break;
+            snprintf(text, sizeof(text), "%s%d%%",
+                    st->charging? "+": "", st->battery);
+            break;
+    }
 
-    cairo_set_source_uint32(xcb_cc, len? COLOR_INPUT: COLOR_LOCK);
+    cairo_save(cc);
+    cairo_rectangle(cc, r[0], r[1], r[2], r[3]);
+    cairo_clip(cc);
+    cairo_set_source_uint32(cc, (1 << item) == STATUS_CAPS && *text?
+            t->color_wrong: bg);
+    cairo_paint(cc);
 
-    cairo_rectangle(xcb_cc, 0, 0, s->width_in_pixels, s->height_in_pixels);
-    cairo_fill(xcb_cc);
+    if (*text) {
+        cairo_text_extents_t te;
+        select_font(cc, t, r[3] * 0.6);
+        cairo_text_extents(cc, text, &te);
+        // caps lock centered, layout left aligned, battery right aligned
+        double x = r[0] + r[3] * 0.2;
+        if ((1 << item) == STATUS_CAPS) x = r[0] + (r[2] - te.width) / 2;
+        if ((1 << item) == STATUS_BATTERY)
+            x = r[0] + r[2] - r[3] * 0.2 - te.width;
+        cairo_set_source_uint32(cc, fg);
+        cairo_move_to(cc, x - te.x_bearing,
+                r[1] + (r[3] - te.height) / 2 - te.y_bearing);
+        cairo_show_text(cc, text);
+    }
+    cairo_restore(cc);
+}
 
-    if (len) draw_input_box(xcb_cc, s->width_in_pixels, s->height_in_pixels,
-            COLOR_INPUT_FG, COLOR_INPUT, TEXT_SIZE / 5, len);
-    cairo_surface_destroy(xcb_cs);
-    cairo_destroy(xcb_cc);
+static void paint_status(cairo_t * cc, const uint16_t width,
+        const uint16_t height, const unsigned items, const int len,
+        const status_t * st) {
+    // resolving the layout may replace the plan, so it goes first
+    const layout_t * l = screen_layout(width, height);
+    const theme_t * t = plan_theme(plan);
+    int i = 0;
+    for (i = 0; i < STATUS_ITEMS; i++)
+        if (items & (1 << i))
+            draw_status_item(cc, l, i,
+                    len? t->color_input: t->color_lock, st);
 }
 
-void lock_screen_error(xcb_connection_t * c, xcb_screen_t * s,
-        xcb_window_t w) {
-    // cached visual_type
-    if (!visual_type) visual_type = get_root_visualitype(s);
+// fade: lit segments fade out, or stay lit till they go out
+static void paint_input(cairo_t * cc,
+        const uint16_t width, const uint16_t height, const int dirty,
+        const int fade, const int len, const indicator_t * ind, const status_t * st,
+        const struct timeval * now) {
+    const layout_t * l = screen_layout(width, height);
+    const theme_t * t = plan_theme(plan);
+    cairo_rectangle_t r = {0, 0, width, height};
+
+    // only the ring changes between frames of the same input state, its
+    // bounding box is all we touch
+    if (dirty) {
+        r.x = l->ind_x;
+        r.y = l->ind_y;
+        r.width  = l->ind_w;
+        r.height = l->ind_h;
+        cairo_rectangle(cc, r.x, r.y, r.width, r.height);
+        cairo_clip(cc);
+    }
+
+    cairo_set_source_uint32(cc, len? t->color_input: t->color_lock);
+    cairo_rectangle(cc, r.x, r.y, r.width, r.height);
+    cairo_fill(cc);
+
+    draw_indicator(cc, l, t->color_input_fg, t->color_indicator_erase,
+            fade, len, ind, now);
 
-    cairo_surface_t * xcb_cs = cairo_xcb_surface_create(c, w, visual_type,
-            s->width_in_pixels, s->height_in_pixels);
-    cairo_t * xcb_cc = cairo_create(xcb_cs);
+    if (!dirty) {
+        cairo_reset_clip(cc);
+        paint_status(cc, width, height, STATUS_ALL, len, st);
+    }
+}
 
+// pre-rendered "ACCESS DENIED" frames, one per screen size, with or
+// without stripes. Screens of the same size, even on different displays,
+// share the same frame. Frames are counted by the canvases using them, and
+// dropped once no screen has that size any more.
+typedef struct frame_t {
+    uint16_t width, height;
+    int stripes;
+    int refs;
+    cairo_surface_t * img;
+    struct frame_t * next;
+} frame_t;
+
+static frame_t * error_frames = NULL;
+
+static frame_t * error_frame_get(const uint16_t width, const uint16_t height,
+        const int stripes) {
+    frame_t * f = NULL;
+    for (f = error_frames; f; f = f->next)
+        if (f->width == width && f->height == height &&
+            f->stripes == stripes) {
+            f->refs++;
+            return f;
+        }
+
+    f = calloc(1, sizeof(frame_t));
+    f->width   = width;
+    f->height  = height;
+    f->stripes = stripes;
+    f->refs    = 1;
+    f->img     = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+
+    const layout_t * l = screen_layout(width, height);
+    const theme_t * t = plan_theme(plan);
+    cairo_t * cc = cairo_create(f->img);
     // draw a red background
-    cairo_set_source_uint32(xcb_cc, COLOR_WRONG);
-    cairo_rectangle(xcb_cc, 0, 0, s->width_in_pixels, s->height_in_pixels);
-    cairo_fill(xcb_cc);
+    cairo_set_source_uint32(cc, t->color_wrong);
+    cairo_rectangle(cc, 0, 0, width, height);
+    cairo_fill(cc);
+
+    if (stripes) draw_stripes(cc, l, t->color_wrong_fg);
+    draw_text(cc, l, t->color_wrong_fg, t->color_wrong);
+    cairo_destroy(cc);
+    cairo_surface_flush(f->img);
+
+    f->next = error_frames;
+    error_frames = f;
+    return f;
+}
+
+static void error_frame_put(frame_t * frame) {
+    frame_t ** f = NULL;
+    if (!frame || --frame->refs) return;
+    for (f = &error_frames; *f; f = &(*f)->next) {
+        if (*f != frame) continue;
+        *f = frame->next;
+        cairo_surface_destroy(frame->img);
+        free(frame);
+        break;
+    }
+}
+
+void lock_screen_free_cache(void) {
+    frame_t * f = NULL;
+    while ((f = error_frames)) {
+        error_frames = f->next;
+        cairo_surface_destroy(f->img);
+        free(f);
+    }
+}
+
+// cairo surface and context of one lock window, kept for its whole life so
+// repaints don't set them up again
+struct canvas_t {
+    xcb_connection_t * conn;
+    xcb_screen_t * screen;
+    xcb_window_t window;
+    uint16_t width, height;
+    cairo_surface_t * cs;
+    cairo_t * cc;
+    enum quality_t quality;
+    frame_t * frame;            // error frame of this size, once needed
+    xcb_pixmap_t pixmap;        // offscreen frame to fade to, once needed
+    cairo_surface_t * pcs;
+    cairo_t * pcc;
+};
+
+// width, height: the window's, the screen's setup may be older
+canvas_t * lock_screen_canvas(xcb_connection_t * c, xcb_screen_t * s,
+        xcb_window_t w, const uint16_t width, const uint16_t height) {
+    canvas_t * cv = calloc(1, sizeof(canvas_t));
+    cv->conn   = c;
+    cv->screen = s;
+    cv->window = w;
+    cv->width  = width;
+    cv->height = height;
+    cv->cs = cairo_xcb_surface_create(c, w, screen_visual(s),
+            cv->width, cv->height);
+    cv->cc = cairo_create(cv->cs);
+    return cv;
+}
 
-    draw_stripes(xcb_cc, s->width_in_pixels, s->height_in_pixels,
-            COLOR_WRONG_FG, COLOR_WRONG, STRIPE_WIDTH, "ACCESS DENIED");
+// made once per size, so fades don't set up cairo every time
+static void canvas_offscreen(canvas_t * cv) {
+    if (cv->pcc) return;
+    cv->pixmap = xcb_generate_id(cv->conn);
+    xcb_create_pixmap(cv->conn, cv->screen->root_depth, cv->pixmap,
+            cv->screen->root, cv->width, cv->height);
+    cv->pcs = cairo_xcb_surface_create(cv->conn, cv->pixmap,
+            screen_visual(cv->screen), cv->width, cv->height);
+    cv->pcc = cairo_create(cv->pcs);
+}
 
-    // reset pass_wrong timer
-    wtimer_rearm(pass_wrong_timer, 0, NULL);
+// a fade still using the pixmap keeps it alive on the server
+static void canvas_offscreen_free(canvas_t * cv) {
+    if (!cv->pcc) return;
+    cairo_destroy(cv->pcc);
+    cairo_surface_destroy(cv->pcs);
+    xcb_free_pixmap(cv->conn, cv->pixmap);
+    cv->pcc = NULL;
+    cv->pcs = NULL;
+}
+
+// the window got a new size, returns 0 if it did not actually change. Only
+// what depends on the size is dropped, layout and frame of the new size
+// are resolved on the next repaint.
+int lock_screen_canvas_resize(canvas_t * cv, const uint16_t width,
+        const uint16_t height) {
+    if (width == cv->width && height == cv->height) return 0;
+    cv->width  = width;
+    cv->height = height;
+    cairo_xcb_surface_set_size(cv->cs, width, height);
+    error_frame_put(cv->frame);
+    cv->frame = NULL;
+    canvas_offscreen_free(cv);
+    return 1;
+}
+
+// what repaints from now on leave out, see enum quality_t
+void lock_screen_quality(canvas_t * cv, const enum quality_t q) {
+    cv->quality = q;
+}
+
+void lock_screen_size(const canvas_t * cv, uint16_t * width,
+        uint16_t * height) {
+    *width  = cv->width;
+    *height = cv->height;
+}
 
-    cairo_surface_destroy(xcb_cs);
-    cairo_destroy(xcb_cc);
+void lock_screen_canvas_free(canvas_t * cv) {
+    error_frame_put(cv->frame);
+    canvas_offscreen_free(cv);
+    cairo_destroy(cv->cc);
+    cairo_surface_destroy(cv->cs);
+    free(cv);
 }
+
+// the error frame for the current quality, the other one is let go
+static cairo_surface_t * canvas_error_frame(canvas_t * cv) {
+    const int stripes = cv->quality < QUALITY_NO_STRIPES;
+    if (cv->frame && cv->frame->stripes != stripes) {
+        error_frame_put(cv->frame);
+        cv->frame = NULL;
+    }
+    if (!cv->frame)
+        cv->frame = error_frame_get(cv->width, cv->height, stripes);
+    return cv->frame->img;
+}
+
+// full: repaint the whole window, otherwise only the ring's bounding box
+void lock_screen_input(canvas_t * cv, const int full, const int len,
+        const indicator_t * ind, const status_t * st,
+        const struct timeval * now) {
+    cairo_save(cv->cc);
+    paint_input(cv->cc, cv->width, cv->height, !full,
+            cv->quality < QUALITY_NO_ANIM, len, ind, st, now);
+    cairo_restore(cv->cc);
+    cairo_surface_flush(cv->cs);
+}
+
+// the input screen, rendered into an offscreen pixmap of the window's size,
+// for fades. The pixmap stays the canvas's, and is drawn over by the next
+// call.
+xcb_pixmap_t lock_screen_input_pixmap(canvas_t * cv, const int len,
+        const indicator_t * ind, const status_t * st,
+        const struct timeval * now) {
+    canvas_offscreen(cv);
+    cairo_save(cv->pcc);
+    paint_input(cv->pcc, cv->width, cv->height, 0,
+            cv->quality < QUALITY_NO_ANIM, len, ind, st, now);
+    cairo_restore(cv->pcc);
+    cairo_surface_flush(cv->pcs);
+    return cv->pixmap;
+}
+
+// lock windows start without background, so they keep showing the desktop
+// to fade in from. Once painted for real, exposes show the lock color.
+void lock_screen_backdrop(canvas_t * cv) {
+    xcb_change_window_attributes(cv->conn, cv->window, XCB_CW_BACK_PIXEL,
+            (uint32_t[]) { plan_theme(plan)->color_lock });
+}
+
+// redraw just the given status items, on top of the input screen
+void lock_screen_status(canvas_t * cv, const unsigned items, const int len,
+        const status_t * st) {
+    paint_status(cv->cc, cv->width, cv->height, items, len, st);
+    cairo_surface_flush(cv->cs);
+}
+
+// limit repaints to an exposed area, until lock_screen_unclip()
+void lock_screen_clip(canvas_t * cv, const int16_t x, const int16_t y,
+        const uint16_t width, const uint16_t height) {
+    cairo_rectangle(cv->cc, x, y, width, height);
+    cairo_clip(cv->cc);
+}
+
+void lock_screen_unclip(canvas_t * cv) {
+    cairo_reset_clip(cv->cc);
+}
+
+void lock_screen_error(canvas_t * cv) {
+    const layout_t * l = screen_layout(cv->width, cv->height);
+    const theme_t * t = plan_theme(plan);
+
+    cairo_save(cv->cc);
+    if (cv->quality >= QUALITY_SOLID) {
+        // a fill and a few glyphs are cheaper than uploading a whole frame
+        cairo_set_source_uint32(cv->cc, t->color_wrong);
+        cairo_paint(cv->cc);
+        draw_text(cv->cc, l, t->color_wrong_fg, t->color_wrong);
+    } else {
+        // just blit the shared pre-rendered frame
+        cairo_set_source_surface(cv->cc, canvas_error_frame(cv), 0, 0);
+        cairo_paint(cv->cc);
+    }
+    cairo_restore(cv->cc);
+    cairo_surface_flush(cv->cs);
+}
+
+// resolve everything a repaint of this window may need, and run each paint
+// path once, so nothing is first touched on a keystroke. Painted into a
+// scratch pixmap of its own, the canvas's offscreen one may be fading in.
+// The window's own surface is warmed by the render thread once the fade is
+// done.
+void lock_screen_warmup(canvas_t * cv, const status_t * st) {
+    xcb_pixmap_t pixmap = xcb_generate_id(cv->conn);
+    const int fade = cv->quality < QUALITY_NO_ANIM;
+    status_t all = { .caps_lock = 1, .layout = "us", .battery = 100 };
+    indicator_t ind;
+    struct timeval now;
+
+    xcb_create_pixmap(cv->conn, cv->screen->root_depth, pixmap,
+            cv->screen->root, cv->width, cv->height);
+    cairo_surface_t * cs = cairo_xcb_surface_create(cv->conn, pixmap,
+            screen_visual(cv->screen), cv->width, cv->height);
+    cairo_t * cc = cairo_create(cs);
+
+    memset(&ind, 0, sizeof(ind));
+    gettimeofday(&now, NULL);
+    canvas_error_frame(cv);
+    indicator_hit(&ind, &now, 0);
+    cairo_save(cc);
+    paint_input(cc, cv->width, cv->height, 0, fade, 0, &ind, &all, &now);
+    cairo_restore(cc);
+    indicator_reset(&ind);
+    paint_input(cc, cv->width, cv->height, 0, fade, 0, &ind, st, &now);
+    cairo_surface_flush(cs);
+
+    cairo_destroy(cc);
+    cairo_surface_destroy(cs);
+    xcb_free_pixmap(cv->conn, pixmap);
+}
+
+#ifdef __BENCH_LOCK_SCREEN__
+// CPU cost of repainting the input screen, whole window versus only the
+// animated ring:
+//   cc -D__BENCH_LOCK_SCREEN__ -std=c99 lock_screen.c config.c -lm
+//      $(pkg-config --cflags --libs xcb cairo)
+#include <stdio.h>
+#include <time.h>
+#include "anim.h"
+
+#define BENCH_FRAMES 500
+
+static double bench_frames(cairo_t * cc, const uint16_t width,
+        const uint16_t height, const int dirty, indicator_t * ind) {
+    status_t st = { .layout = "us", .battery = 80 };
+    struct timeval now;
+    int i = 0;
+    gettimeofday(&now, NULL);
+
+    clock_t start = clock();
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        // a keystroke every 4 frames, frames 1/60s apart
+        if (i % 4 == 0) indicator_hit(ind, &now, i % 12 == 0);
+        now.tv_usec += ANIM_FRAME_US;
+        if (now.tv_usec >= 1000000) { now.tv_sec++; now.tv_usec -= 1000000; }
+
+        cairo_save(cc);
+        paint_input(cc, width, height, dirty, 1, 8, ind, &st, &now);
+        cairo_restore(cc);
+    }
+    cairo_surface_flush(cairo_get_target(cc));
+    return (clock() - start) * 1e6 / CLOCKS_PER_SEC / BENCH_FRAMES;
+}
+
+int main(void) {
+    static const uint16_t sizes[][2] = {{1920, 1080}, {3840, 2160}};
+    indicator_t ind = {{0}};
+    int i = 0;
+
+    lock_screen_init(plan_load());
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        cairo_surface_t * img = cairo_image_surface_create(
+                CAIRO_FORMAT_RGB24, sizes[i][0], sizes[i][1]);
+        cairo_t * cc = cairo_create(img);
+
+        double full  = bench_frames(cc, sizes[i][0], sizes[i][1], 0, &ind);
+        double dirty = bench_frames(cc, sizes[i][0], sizes[i][1], 1, &ind);
+        printf("%4dx%-4d  full frame %8.1fus CPU, "
+                "animated frame %8.1fus CPU\n",
+                sizes[i][0], sizes[i][1], full, dirty);
+
+        cairo_destroy(cc);
+        cairo_surface_destroy(img);
+    }
+    return 0;
+}
+
+#endif
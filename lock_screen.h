@@ -3,6 +3,10 @@
 
 #include <xcb/xcb.h>
 #include <stdint.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "status.h"
 
 // default color config
 #if !defined COLOR_LOCK
@@ -25,15 +29,71 @@
 #   define COLOR_WRONG (uint32_t)(0x9c3200)
 #endif
 
-void lock_screen_input(xcb_connection_t * c, xcb_screen_t * s,
-        xcb_window_t w, const int len);
-void lock_screen_error(xcb_connection_t * c, xcb_screen_t * s,
-        xcb_window_t w);
+#if !defined COLOR_INDICATOR_ERASE
+#   define COLOR_INDICATOR_ERASE COLOR_WRONG_FG
+#endif
+
+#if !defined INDICATOR_SEGMENTS
+#   define INDICATOR_SEGMENTS 10
+#endif
 
-#if !defined PASS_SHOW_LEN
-#   define PASS_SHOW_LEN 16
+// how long a lit segment takes to fade out, in us
+#if !defined INDICATOR_FADE
+#   define INDICATOR_FADE (400 * 1000)
 #endif
 
+// typing feedback ring, one segment lights up and fades on each keystroke
+typedef struct {
+    int64_t lit[INDICATOR_SEGMENTS];    // when lit, in us, 0 for never
+    uint8_t erase[INDICATOR_SEGMENTS];  // lit by backspace
+    uint32_t seed;
+} indicator_t;
+
+void indicator_reset(indicator_t * ind);
+void indicator_hit(indicator_t * ind, const struct timeval * now,
+        const int erase);
+int indicator_active(const indicator_t * ind, const struct timeval * now);
+
+// picture quality of a canvas, stepped down by the render thread when
+// frames take longer than the budget, each level drops everything the ones
+// above it do
+enum quality_t {
+    QUALITY_FULL = 0,
+    QUALITY_NO_STRIPES,         // denied frame without the stripes
+    QUALITY_NO_ANIM,            // no fades, segments don't fade out
+    QUALITY_SOLID,              // denied frame filled, not an image blit
+    QUALITY_MIN = QUALITY_SOLID,
+};
+
+unsigned indicator_lit(const indicator_t * ind, const struct timeval * now);
+
+typedef struct canvas_t canvas_t;
+
+canvas_t * lock_screen_canvas(xcb_connection_t * c, xcb_screen_t * s,
+        xcb_window_t w, const uint16_t width, const uint16_t height);
+int lock_screen_canvas_resize(canvas_t * cv, const uint16_t width,
+        const uint16_t height);
+void lock_screen_quality(canvas_t * cv, const enum quality_t q);
+void lock_screen_size(const canvas_t * cv, uint16_t * width,
+        uint16_t * height);
+void lock_screen_canvas_free(canvas_t * cv);
+void lock_screen_input(canvas_t * cv, const int full, const int len,
+        const indicator_t * ind, const status_t * st,
+        const struct timeval * now);
+xcb_pixmap_t lock_screen_input_pixmap(canvas_t * cv, const int len,
+        const indicator_t * ind, const status_t * st,
+        const struct timeval * now);
+void lock_screen_backdrop(canvas_t * cv);
+void lock_screen_status(canvas_t * cv, const unsigned items, const int len,
+        const status_t * st);
+void lock_screen_clip(canvas_t * cv, const int16_t x, const int16_t y,
+        const uint16_t width, const uint16_t height);
+void lock_screen_unclip(canvas_t * cv);
+void lock_screen_error(canvas_t * cv);
+void lock_screen_warmup(canvas_t * cv, const status_t * st);
+void lock_screen_free_cache(void);
+void lock_screen_init(plan_t * p);
+
 #if !defined TEXT_SIZE
 #   define TEXT_SIZE 65
 #endif
@@ -42,4 +102,9 @@ void lock_screen_error(xcb_connection_t * c, xcb_screen_t * s,
 #   define STRIPE_WIDTH 17
 #endif
 
+// time a frame may take before quality is stepped down, in us
+#if !defined FRAME_BUDGET
+#   define FRAME_BUDGET (1000 * 1000 / 60)
+#endif
+
 #endif
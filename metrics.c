@@ -0,0 +1,106 @@
+// clock_gettime() is not in c99
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+
+// Everything lives in static storage, recording a metric never allocates.
+// Set WSLOCK_METRICS to a file name, or "-" for stderr, to get them dumped
+// on exit. With WSLOCK_METRICS_RESET set too, every dump starts them over,
+// so each one covers only the time since the last.
+
+#define METRIC_BUCKETS 32       // log2(us) buckets, for percentiles
+
+typedef struct {
+    int64_t count, total, min, max, last;
+    int64_t bucket[METRIC_BUCKETS];
+} metric_stat_t;
+
+static metric_stat_t stats[METRIC_MAX];
+
+static const char * metric_names[METRIC_MAX] = {
+    [METRIC_KEY_LATENCY]  = "key_latency",
+    [METRIC_HOTPLUG]      = "hotplug_covered",
+    [METRIC_RELOCK_GAP]   = "relock_gap",
+    [METRIC_ALLOC_KEY]    = "allocs_key",
+    [METRIC_ALLOC_LOOP]   = "allocs_loop",
+    [METRIC_ALLOC_RENDER] = "allocs_render",
+    [METRIC_ALLOC_FRAME]  = "allocs_frame",
+    [METRIC_FRAME_TIME]   = "frame_time",
+    [METRIC_ROUND_TRIP]   = "round_trip",
+    [METRIC_QUALITY]      = "quality",
+    [METRIC_QUALITY_DOWN] = "quality_down",
+};
+
+// levels rather than times, one bucket per level so percentiles are exact
+static const int metric_levels[METRIC_MAX] = {
+    [METRIC_QUALITY]      = 1,
+    [METRIC_QUALITY_DOWN] = 1,
+};
+
+int64_t metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void metric_time(const enum metric_t m, const int64_t us) {
+    metric_stat_t * s = stats + m;
+    int b = 0;
+
+    if (!s->count || us < s->min) s->min = us;
+    if (us > s->max) s->max = us;
+    s->count++;
+    s->total += us;
+    s->last   = us;
+
+    if (metric_levels[m])
+        b = us < 0? 0: us < METRIC_BUCKETS? us: METRIC_BUCKETS - 1;
+    else
+        while (b < METRIC_BUCKETS - 1 && (1LL << b) <= us) b++;
+    s->bucket[b]++;
+}
+
+// upper bound of the bucket holding the p-th percentile, the level itself
+// for levels
+static int64_t percentile(const enum metric_t m, const int p) {
+    const metric_stat_t * s = stats + m;
+    int64_t seen = 0, want = (s->count * p + 99) / 100;
+    int b = 0;
+    for (b = 0; b < METRIC_BUCKETS; b++)
+        if ((seen += s->bucket[b]) >= want) break;
+    if (metric_levels[m]) return b;
+    return b? (1LL << b): 1;
+}
+
+void metrics_dump(void) {
+    const char * path = getenv("WSLOCK_METRICS");
+    FILE * f = NULL;
+    int i = 0;
+
+    if (!path || !*path) return;
+    if (!(f = strcmp(path, "-")? fopen(path, "a"): stderr)) {
+        perror("fopen()");
+        return;
+    }
+
+    fprintf(f, "%-16s %8s %8s %8s %8s %8s %8s %8s\n",
+            "metric", "count", "min", "avg", "p50", "p99", "max", "last");
+    for (i = 0; i < METRIC_MAX; i++) {
+        const metric_stat_t * s = stats + i;
+        if (!s->count) continue;
+        fprintf(f, "%-16s %8lld %8lld %8lld %8lld %8lld %8lld %8lld\n",
+                metric_names[i], (long long)s->count, (long long)s->min,
+                (long long)(s->total / s->count),
+                (long long)percentile(i, 50), (long long)percentile(i, 99),
+                (long long)s->max, (long long)s->last);
+    }
+
+    if (f != stderr) fclose(f);
+    if (getenv("WSLOCK_METRICS_RESET")) memset(stats, 0, sizeof(stats));
+}
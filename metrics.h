@@ -0,0 +1,27 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+
+// latency metrics, in us, allocation counts of test builds, and the
+// picture quality the render thread settled on
+enum metric_t {
+    METRIC_KEY_LATENCY = 0,     // keypress readable to its frame flushed
+    METRIC_HOTPLUG,             // screen resize readable to window covering
+    METRIC_RELOCK_GAP,          // locker reaped to supervisor holding grabs
+    METRIC_ALLOC_KEY,           // allocations handling one keystroke
+    METRIC_ALLOC_LOOP,          // allocations in one input loop iteration
+    METRIC_ALLOC_RENDER,        // allocations in one render loop iteration
+    METRIC_ALLOC_FRAME,         // the same, for iterations drawing keystrokes
+    METRIC_FRAME_TIME,          // our paint plus the server's, of a frame
+    METRIC_ROUND_TRIP,          // frame flushed till the server answered
+    METRIC_QUALITY,             // quality level of each frame, 0 is full
+    METRIC_QUALITY_DOWN,        // level stepped down to, once per step
+    METRIC_MAX,
+};
+
+int64_t metrics_now(void);
+void metric_time(const enum metric_t m, const int64_t us);
+void metrics_dump(void);
+
+#endif
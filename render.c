@@ -0,0 +1,685 @@
+// pthread_sigmask() is not in c99
+#define _XOPEN_SOURCE 500
+
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#include "render.h"
+#include "lock_screen.h"
+#include "timer.h"
+#include "anim.h"
+#include "metrics.h"
+#include "status.h"
+#include "fade.h"
+#include "alloc.h"
+
+// Everything drawn is drawn on its own thread, so a slow repaint never
+// holds up reading the next keystroke. The input side pushes small commands
+// into a lock-free single producer, single consumer ring and pokes an
+// eventfd. The render thread applies all queued commands to its own copy of
+// the state, then paints once, so when it falls behind only the newest
+// state is drawn.
+//
+// The render thread has its own connection to every display. The lock
+// windows are created and grabbed by the input side, only drawn on here.
+// XKB and battery status are read here too, they only change the picture.
+//
+// Locking, and going back from the denied frame to input, fade to the new
+// frame, see fade.c. Fades are server side and only start once the first
+// paint is due, the grabs never wait for them.
+//
+// Quality is governed for each display on its own. A frame's time is our
+// paint, plus however much longer than usual the server took to answer a
+// round trip sent right after it, so the server's drawing counts but the
+// network doesn't. The round trip is never waited for, its reply is picked
+// up with the events, and frames painted while one is out aren't timed.
+// When the running average goes over the frame budget, quality is stepped
+// down one level, see enum quality_t. Once frames take a quarter of the
+// budget again, it is stepped back up after a while. Each time a step up is
+// undone right away that while doubles, so a machine on the edge doesn't
+// flap between two levels.
+
+// a power of 2, far more than keystrokes in a frame
+#define RENDER_QUEUE 1024
+
+// how long a level is kept before trying the one above, in us, at first
+// and at most
+#define QUALITY_HOLD     (2 * 1000 * 1000)
+#define QUALITY_HOLD_MAX (64 * 1000 * 1000)
+
+typedef struct {
+    uint32_t head;              // next slot written, by the input side only
+    char pad0[60];              // keep head and tail on their own lines
+    uint32_t tail;              // next slot read, by the render thread only
+    char pad1[60];
+    render_cmd_t cmds[RENDER_QUEUE];
+} queue_t;
+
+typedef struct {
+    xcb_window_t window;
+    canvas_t * canvas;
+    fade_t * fade;              // NULL without RENDER
+    int backdrop;               // window still has no background
+    int full;                   // repaint everything
+    int damaged;                // exposed since the last paint
+    int16_t x1, y1, x2, y2;     // bounding box of the exposed area
+    int64_t resized;            // when the resize was seen, 0 for none
+} surface_t;
+
+typedef struct {
+    enum quality_t level;
+    int64_t budget;             // in us
+    int64_t avg;                // running average of frame times
+    int64_t changed;            // when the level last changed
+    int64_t hold;               // wait before stepping up
+    int up;                     // last change was a step up
+    unsigned probe;             // round trip out after a frame, 0 for none
+    int64_t sent;               // when it was sent
+    int64_t paint;              // our part of that frame
+    int64_t rtt;                // quickest round trip seen, the network's
+} governor_t;
+
+// what one display shows
+typedef struct {
+    xcb_connection_t * conn;
+    surface_t * screens;
+    int ns;
+    int len;
+    int error;
+    int fade;                   // fade in the next full repaint
+    indicator_t ind;
+    int animating;              // indicator still fading
+    int ring;                   // indicator needs a frame
+    unsigned lit;               // segments showing in the last frame
+    unsigned items;             // status items changed
+    status_t status;
+    status_xkb_t * xkb;
+    governor_t gov;
+    int dead;
+} view_t;
+
+struct render_t {
+    queue_t queue;
+    int wake_fd;                // eventfd, poked after each push
+    int epoll_fd;
+    int uevent_fd;              // power_supply uevents, -1 for none
+    view_t * views;
+    int nd;
+    wtimer_list_t * tl;
+    anim_sched_t * anim;
+    int tick;                   // a frame is due for running fades
+    int warming;                // --resident, screens still to warm up
+    int warm_view, warm_screen; // the next one
+    int quit;
+    int64_t keyed[RENDER_QUEUE]; // keystrokes waiting for their frame
+    int nkeyed;
+    pthread_t thread;
+};
+
+static int queue_push(queue_t * q, const render_cmd_t * cmd) {
+    uint32_t head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == RENDER_QUEUE)
+        return 0;
+    q->cmds[head & (RENDER_QUEUE - 1)] = *cmd;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int queue_pop(queue_t * q, render_cmd_t * cmd) {
+    uint32_t tail = q->tail;
+    if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) return 0;
+    *cmd = q->cmds[tail & (RENDER_QUEUE - 1)];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static void view_full(view_t * v) {
+    int i = 0;
+    for (i = 0; i < v->ns; i++) v->screens[i].full = 1;
+}
+
+static void view_damage(view_t * v, const render_cmd_t * cmd) {
+    int16_t x2 = cmd->x + cmd->width, y2 = cmd->y + cmd->height;
+    surface_t * s = NULL;
+
+    if (cmd->screen >= v->ns) return;
+    s = v->screens + cmd->screen;
+    if (!s->damaged) {
+        s->x1 = cmd->x;
+        s->y1 = cmd->y;
+        s->x2 = x2;
+        s->y2 = y2;
+        s->damaged = 1;
+        return;
+    }
+    if (cmd->x < s->x1) s->x1 = cmd->x;
+    if (cmd->y < s->y1) s->y1 = cmd->y;
+    if (x2 > s->x2) s->x2 = x2;
+    if (y2 > s->y2) s->y2 = y2;
+}
+
+static void view_resize(view_t * v, const render_cmd_t * cmd) {
+    surface_t * s = NULL;
+
+    if (cmd->screen >= v->ns) return;
+    s = v->screens + cmd->screen;
+    // the window may be behind the canvas, it is configured either way
+    lock_screen_canvas_resize(s->canvas, cmd->width, cmd->height);
+
+    xcb_configure_window(v->conn, s->window,
+            XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+            XCB_CONFIG_WINDOW_STACK_MODE,
+            (uint32_t[]) { cmd->width, cmd->height, XCB_STACK_MODE_ABOVE });
+    s->full    = 1;
+    s->resized = cmd->seen;
+}
+
+static void apply(render_t * r, const render_cmd_t * cmd,
+        const struct timeval * now) {
+    view_t * v = r->views + cmd->display;
+
+    switch (cmd->type) {
+        case RENDER_STATE:
+            if (cmd->error) {
+                indicator_reset(&v->ind);
+                v->animating = 0;
+            }
+            if (v->error && !cmd->error) v->fade = 1;
+            v->error = cmd->error;
+            v->len   = cmd->len;
+            view_full(v);
+            break;
+
+        case RENDER_LEN:
+            if (cmd->len != v->len) {
+                indicator_hit(&v->ind, now, cmd->len < v->len);
+                v->animating = 1;
+                anim_sched_kick(r->anim, now, INDICATOR_FADE);
+            }
+            // background only changes on empty <-> non-empty
+            if (v->error || !v->len != !cmd->len) view_full(v);
+            v->error = 0;
+            v->fade  = 0;
+            v->len   = cmd->len;
+            v->ring  = 1;
+            r->keyed[r->nkeyed++] = cmd->seen;
+            break;
+
+        case RENDER_EXPOSE:
+            view_damage(v, cmd);
+            break;
+
+        case RENDER_RESIZE:
+            view_resize(v, cmd);
+            break;
+
+        case RENDER_DUMP:
+            metrics_dump();
+            break;
+
+        case RENDER_QUIT:
+            r->quit = 1;
+            break;
+    }
+}
+
+// returns non-zero if anything was drawn
+static int paint_surface(render_t * r, view_t * v, surface_t * s,
+        const struct timeval * now) {
+    canvas_t * cv = s->canvas;
+    uint16_t width = 0, height = 0;
+    const int anim = v->gov.level < QUALITY_NO_ANIM;
+    int drawn = s->full || s->damaged || v->ring || v->items;
+
+    // anything drawn directly ends a fade first
+    if (fade_running(s->fade) && (drawn || !anim))
+        fade_finish(s->fade);
+
+    if (s->full && v->fade && s->fade && anim) {
+        lock_screen_size(cv, &width, &height);
+        fade_start(s->fade, lock_screen_input_pixmap(cv, v->len, &v->ind,
+                    &v->status, now), width, height);
+        anim_sched_kick(r->anim, now, ANIM_FRAME_US);
+        s->full = s->damaged = 0;
+        return 1;
+    }
+
+    if (s->full || s->damaged) {
+        if (!s->full)
+            lock_screen_clip(cv, s->x1, s->y1,
+                    s->x2 - s->x1, s->y2 - s->y1);
+        if (v->error) lock_screen_error(cv);
+        else lock_screen_input(cv, 1, v->len, &v->ind, &v->status, now);
+        if (!s->full) lock_screen_unclip(cv);
+    }
+
+    if (!s->full && !v->error) {
+        if (v->ring)
+            lock_screen_input(cv, 0, v->len, &v->ind, &v->status, now);
+        if (v->items)
+            lock_screen_status(cv, v->items, v->len, &v->status);
+    }
+    s->full = s->damaged = 0;
+
+    if (r->tick && fade_running(s->fade)) {
+        fade_step(s->fade);
+        drawn = 1;
+    }
+    // painted for real, exposes can show the lock color from now on
+    if (s->backdrop && !fade_running(s->fade)) {
+        lock_screen_backdrop(cv);
+        s->backdrop = 0;
+        // faded in offscreen: one ring frame on the window itself, same
+        // pixels, so the first keystroke finds its surface set up
+        if (s->fade && !v->error)
+            lock_screen_input(cv, 0, v->len, &v->ind, &v->status, now);
+    }
+    return drawn;
+}
+
+static void set_quality(view_t * v, const enum quality_t q,
+        const int64_t now) {
+    governor_t * g = &v->gov;
+    int i = 0;
+
+    g->up      = q < g->level;
+    g->level   = q;
+    g->changed = now;
+    // halfway, neither too slow nor fast enough, till new frames tell
+    g->avg     = g->budget / 2;
+    for (i = 0; i < v->ns; i++) lock_screen_quality(v->screens[i].canvas, q);
+}
+
+static void govern(view_t * v, const int64_t us, const int64_t now) {
+    governor_t * g = &v->gov;
+
+    metric_time(METRIC_FRAME_TIME, us);
+    metric_time(METRIC_QUALITY, g->level);
+    g->avg += (us - g->avg) / 8;
+
+    if (g->avg > g->budget && g->level < QUALITY_MIN) {
+        // the last step up was too early, wait longer next time
+        if (g->up && now - g->changed < g->hold && g->hold < QUALITY_HOLD_MAX)
+            g->hold *= 2;
+        set_quality(v, g->level + 1, now);
+        metric_time(METRIC_QUALITY_DOWN, g->level);
+    } else if (g->avg < g->budget / 4 && g->level > QUALITY_FULL &&
+               now - g->changed >= g->hold) {
+        set_quality(v, g->level - 1, now);
+    }
+}
+
+// the round trip after the last timed frame came back: the server drew it
+static void probe_check(view_t * v) {
+    governor_t * g = &v->gov;
+    void * reply = NULL;
+    xcb_generic_error_t * error = NULL;
+    int64_t now = 0, rtt = 0;
+    int done = 0;
+
+    if (!g->probe) return;
+    // replies come in memory libxcb allocated, like events
+    alloc_exempt(1);
+    done = xcb_poll_for_reply(v->conn, g->probe, &reply, &error);
+    free(reply);
+    free(error);
+    alloc_exempt(0);
+    if (!done) return;
+
+    now = metrics_now();
+    rtt = now - g->sent;
+    g->probe = 0;
+    metric_time(METRIC_ROUND_TRIP, rtt);
+    if (rtt < g->rtt) g->rtt = rtt;
+    govern(v, g->paint + rtt - g->rtt, now);
+}
+
+// time a frame that took us paint us, unless the last one is still out
+static void probe_send(view_t * v, const int64_t paint) {
+    governor_t * g = &v->gov;
+
+    if (g->probe) return;
+    g->probe = xcb_get_input_focus(v->conn).sequence;
+    g->sent  = metrics_now();
+    g->paint = paint;
+    xcb_flush(v->conn);
+}
+
+// one paint for whatever changed since the last one
+static void paint(render_t * r, const struct timeval * now) {
+    view_t * v = NULL;
+    int64_t start = 0;
+    int i = 0, drawn = 0;
+
+    for (v = r->views; v < r->views + r->nd; v++) {
+        if (v->dead) continue;
+        start = metrics_now();
+        drawn = 0;
+        for (i = 0; i < v->ns; i++)
+            drawn |= paint_surface(r, v, v->screens + i, now);
+        xcb_flush(v->conn);
+        if (drawn) probe_send(v, metrics_now() - start);
+        v->fade = 0;
+
+        if (v->ring) {
+            v->animating = indicator_active(&v->ind, now);
+            v->lit       = indicator_lit(&v->ind, now);
+        }
+        v->ring  = 0;
+        v->items = 0;
+
+        // covered once the server has the new geometry
+        for (i = 0; i < v->ns; i++) {
+            surface_t * s = v->screens + i;
+            if (!s->resized) continue;
+            free(xcb_get_geometry_reply(v->conn,
+                        xcb_get_geometry(v->conn, s->window), NULL));
+            metric_time(METRIC_HOTPLUG, metrics_now() - s->resized);
+            s->resized = 0;
+        }
+        // waiting on the geometry may have read the reply in
+        probe_check(v);
+    }
+
+    for (i = 0; i < r->nkeyed; i++)
+        metric_time(METRIC_KEY_LATENCY, metrics_now() - r->keyed[i]);
+    r->nkeyed = 0;
+    r->tick   = 0;
+}
+
+// --resident: the next screen can be warmed up. Not while a frame of its
+// display is being timed, that frame would be charged the warm-up's drawing.
+static int warm_ready(const render_t * r) {
+    const view_t * v = r->views + r->warm_view;
+    return r->warming && (v->dead || !v->gov.probe);
+}
+
+// warm up the next screen, one per loop, so the fade-in runs meanwhile.
+// Returns 0 once all are warm.
+static int warm_next(render_t * r) {
+    view_t * v = r->views + r->warm_view;
+
+    if (!v->dead) {
+        lock_screen_warmup(v->screens[r->warm_screen].canvas, &v->status);
+        // and so would the next one, wait for the server to be done
+        alloc_exempt(1);
+        free(xcb_get_input_focus_reply(v->conn,
+                    xcb_get_input_focus(v->conn), NULL));
+        alloc_exempt(0);
+    }
+    if (++r->warm_screen >= v->ns) {
+        r->warm_screen = 0;
+        r->warm_view++;
+    }
+    return r->warm_view < r->nd;
+}
+
+// one frame for all running indicator animations and fades, only the ring
+// is redrawn
+static void frame_cb(anim_sched_t * as, const struct timeval * now,
+        void * data) {
+    render_t * r = data;
+    view_t * v = NULL;
+    int i = 0;
+
+    r->tick = 1;
+    for (v = r->views; v < r->views + r->nd; v++) {
+        // segments don't fade without animations, only going out is drawn
+        if (v->animating && !v->error &&
+            (v->gov.level < QUALITY_NO_ANIM ||
+             indicator_lit(&v->ind, now) != v->lit))
+            v->ring = 1;
+        // fades go on for as many frames as they take, however late
+        for (i = 0; i < v->ns; i++)
+            if (fade_running(v->screens[i].fade))
+                anim_sched_kick(as, now, ANIM_FRAME_US);
+    }
+}
+
+// battery changed, same machine for every display
+static void handle_uevents(render_t * r) {
+    status_t bat = r->views->status;
+    view_t * v = NULL;
+
+    if (!status_uevent_read(r->uevent_fd, &bat)) return;
+
+    for (v = r->views; v < r->views + r->nd; v++) {
+        v->status.battery  = bat.battery;
+        v->status.charging = bat.charging;
+        v->items |= STATUS_BATTERY;
+    }
+}
+
+// our own connection only sees XKB notifications, errors, and the replies
+// to frame round trips
+static void handle_view_events(render_t * r, view_t * v) {
+    xcb_generic_event_t * event;
+
+    while ((event = alloc_poll_event(v->conn))) {
+        v->items |= status_xkb_event(v->xkb, event, &v->status);
+        free(event);
+    }
+    probe_check(v);
+
+    if (xcb_connection_has_error(v->conn)) {
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL,
+                xcb_get_file_descriptor(v->conn), NULL);
+        v->dead = 1;
+    }
+}
+
+static void * render_main(void * data) {
+    render_t * r = data;
+    struct epoll_event evs[r->nd + 2];
+    struct timeval now;
+    render_cmd_t cmd;
+    uint64_t wakes = 0;
+    int64_t to = -1, allocs = 0;
+    int nev = 0, more = 0, i = 0, n = 0, keyed = 0;
+
+    while (!r->quit) {
+        allocs = alloc_count();
+        gettimeofday(&now, NULL);
+        to = more || warm_ready(r)? 0: wtimer_list_next_timeout(r->tl, &now);
+        if (to > 0) to = (to + 999) / 1000;
+
+        nev = epoll_wait(r->epoll_fd, evs, r->nd + 2, to);
+        if (nev < 0 && errno != EINTR) {
+            perror("render thread epoll_wait()");
+            break;
+        }
+
+        gettimeofday(&now, NULL);
+        for (i = 0; i < nev; i++) {
+            if (evs[i].data.ptr == &r->wake_fd) {
+                if (read(r->wake_fd, &wakes, sizeof(wakes)) < 0 &&
+                    errno != EAGAIN)
+                    perror("render thread eventfd read()");
+            } else if (evs[i].data.ptr == &r->uevent_fd) {
+                handle_uevents(r);
+            } else {
+                handle_view_events(r, evs[i].data.ptr);
+            }
+        }
+
+        // at most one queue worth per paint, the rest right after it
+        for (n = 0; n < RENDER_QUEUE && queue_pop(&r->queue, &cmd); n++)
+            apply(r, &cmd, &now);
+        more = n == RENDER_QUEUE;
+
+        wtimer_list_timeout(r->tl, &now);
+        keyed = r->nkeyed;
+        paint(r, &now);
+        // keystrokes first, warm-up is for the ones after them
+        if (warm_ready(r) && !keyed) r->warming = warm_next(r);
+        alloc_metric(METRIC_ALLOC_RENDER, allocs);
+        if (keyed) alloc_metric(METRIC_ALLOC_FRAME, allocs);
+    }
+
+    return NULL;
+}
+
+static void epoll_add(render_t * r, const int fd, void * ptr) {
+    struct epoll_event ev;
+    ev.events   = EPOLLIN;
+    ev.data.ptr = ptr;
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+        perror("epoll_ctl()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// budget: time a frame may take, in us
+render_t * render_new(const char ** names, const int nd,
+        const uint32_t budget) {
+    render_t * r = calloc(1, sizeof(render_t));
+    view_t * v = NULL;
+
+    r->nd    = nd;
+    r->views = calloc(nd, sizeof(view_t));
+    for (v = r->views; v < r->views + nd; v++) {
+        const char * name = names[v - r->views];
+        v->conn = xcb_connect(name, NULL);
+        if (!v->conn || xcb_connection_has_error(v->conn)) {
+            fprintf(stderr, "unable to open render connection to %s\n",
+                    name? name: "$DISPLAY");
+            exit(EXIT_FAILURE);
+        }
+        v->ns         = xcb_setup_roots_length(xcb_get_setup(v->conn));
+        v->screens    = calloc(v->ns, sizeof(surface_t));
+        v->gov.budget = budget;
+        v->gov.hold   = QUALITY_HOLD;
+    }
+    return r;
+}
+
+// the lock window of a screen, created by the input side and already known
+// to the server, and the size it was created with
+void render_window(render_t * r, const int display, const int screen,
+        const xcb_window_t w, const uint16_t width, const uint16_t height) {
+    view_t * v = r->views + display;
+    xcb_screen_iterator_t iter = xcb_setup_roots_iterator(
+            xcb_get_setup(v->conn));
+    int i = 0;
+
+    for (i = 0; i < screen; i++) xcb_screen_next(&iter);
+    v->screens[screen].window   = w;
+    v->screens[screen].canvas   = lock_screen_canvas(v->conn, iter.data, w,
+            width, height);
+    v->screens[screen].backdrop = 1;
+#if !defined(NO_FADE)
+    v->screens[screen].fade     = fade_new(v->conn, iter.data, w);
+#endif
+}
+
+// status sources and first paint, before the thread runs. The fade-in
+// starts right away, warm-up is done by the thread while it runs.
+void render_start(render_t * r, const int warmup) {
+    struct timeval now;
+    struct sched_param sp = { .sched_priority = 0 };
+    pthread_attr_t attr;
+    sigset_t all, old;
+    view_t * v = NULL;
+    int64_t sent = 0;
+
+    r->tl   = wtimer_list_new(0);
+    r->anim = anim_sched_new(r->tl, ANIM_FRAME_US, frame_cb, r);
+
+    r->epoll_fd = epoll_create(1);
+    r->wake_fd  = eventfd(0, EFD_NONBLOCK);
+    if (r->epoll_fd < 0 || r->wake_fd < 0) {
+        perror("render thread");
+        exit(EXIT_FAILURE);
+    }
+    epoll_add(r, r->wake_fd, &r->wake_fd);
+
+    r->uevent_fd = status_uevent_open();
+    if (r->uevent_fd >= 0) epoll_add(r, r->uevent_fd, &r->uevent_fd);
+    status_battery_init(&r->views->status);
+
+    for (v = r->views; v < r->views + r->nd; v++) {
+        v->status.battery  = r->views->status.battery;
+        v->status.charging = r->views->status.charging;
+        v->xkb = status_xkb_init(v->conn, &v->status);
+        epoll_add(r, xcb_get_file_descriptor(v->conn), v);
+
+        // a first guess at the network's part of frame round trips
+        sent = metrics_now();
+        free(xcb_get_input_focus_reply(v->conn,
+                    xcb_get_input_focus(v->conn), NULL));
+        v->gov.rtt = metrics_now() - sent;
+    }
+
+    // first paint, with the status overlay, fading in
+    wtimer_list_start(r->tl);
+    gettimeofday(&now, NULL);
+    for (v = r->views; v < r->views + r->nd; v++) {
+        view_full(v);
+        v->fade = 1;
+    }
+    paint(r, &now);
+    r->warming = warmup;
+
+    // signals are for the input side, and so is --priority, drawing is
+    // done at normal priority whatever the input thread runs at
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &sp);
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (pthread_create(&r->thread, &attr, render_main, r)) {
+        perror("pthread_create()");
+        exit(EXIT_FAILURE);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+// returns 0 if the queue is full, the command is dropped then
+int render_push(render_t * r, const render_cmd_t * cmd) {
+    uint64_t one = 1;
+
+    if (!queue_push(&r->queue, cmd)) return 0;
+    if (write(r->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        perror("render thread eventfd write()");
+    return 1;
+}
+
+void render_stop(render_t * r) {
+    render_cmd_t quit = { .type = RENDER_QUIT };
+    view_t * v = NULL;
+    int i = 0;
+
+    while (!render_push(r, &quit)) usleep(1000);
+    pthread_join(r->thread, NULL);
+
+    for (v = r->views; v < r->views + r->nd; v++) {
+        for (i = 0; i < v->ns; i++) {
+            fade_free(v->screens[i].fade);
+            lock_screen_canvas_free(v->screens[i].canvas);
+        }
+        status_xkb_free(v->xkb);
+        xcb_disconnect(v->conn);
+        free(v->screens);
+    }
+
+    anim_sched_free(r->anim);
+    free(r->tl);
+    close(r->epoll_fd);
+    close(r->wake_fd);
+    if (r->uevent_fd >= 0) close(r->uevent_fd);
+    free(r->views);
+    free(r);
+}
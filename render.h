@@ -0,0 +1,38 @@
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+// what the input side tells the render thread
+enum render_cmd_type_t {
+    RENDER_STATE = 0,           // input screen or the denied frame
+    RENDER_LEN,                 // a keystroke, with the new input length
+    RENDER_EXPOSE,              // part of a lock window needs repainting
+    RENDER_RESIZE,              // a screen got a new size
+    RENDER_DUMP,                // dump metrics
+    RENDER_QUIT,
+};
+
+typedef struct {
+    uint8_t type;
+    uint8_t display;
+    uint8_t screen;             // RENDER_EXPOSE, RENDER_RESIZE
+    uint8_t error;              // RENDER_STATE: showing the denied frame
+    uint16_t len;               // RENDER_STATE, RENDER_LEN
+    int16_t x, y;               // RENDER_EXPOSE
+    uint16_t width, height;     // RENDER_EXPOSE, RENDER_RESIZE
+    int64_t seen;               // when the input side saw it, in us
+} render_cmd_t;
+
+typedef struct render_t render_t;
+
+render_t * render_new(const char ** names, const int nd,
+        const uint32_t budget);
+void render_window(render_t * r, const int display, const int screen,
+        const xcb_window_t w, const uint16_t width, const uint16_t height);
+void render_start(render_t * r, const int warmup);
+int render_push(render_t * r, const render_cmd_t * cmd);
+void render_stop(render_t * r);
+
+#endif
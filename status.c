@@ -0,0 +1,237 @@
+// struct sockaddr_nl and friends are not in c99
+#define _DEFAULT_SOURCE
+
+#include <unistd.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <xcb/xcb.h>
+#include <xcb/xkb.h>
+
+#include "status.h"
+
+// Everything here is event driven: battery from kernel uevents over
+// netlink, caps lock and layout from XKB notifications. sysfs is only read
+// once at startup, for the battery state we had before the first uevent.
+
+// name of the battery shown, the first one found, "" till there is one
+static char supply[64];
+
+int status_uevent_open(void) {
+    struct sockaddr_nl sa;
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+            NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        perror("socket(NETLINK_KOBJECT_UEVENT)");
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = 1;           // kernel uevents
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa))) {
+        perror("bind(NETLINK_KOBJECT_UEVENT)");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int read_sysfs_line(const char * dir, const char * name,
+        char * buf, const int len) {
+    char path[512];
+    snprintf(path, sizeof(path), "/sys/class/power_supply/%s/%s", dir, name);
+    FILE * f = fopen(path, "r");
+    if (!f) return 1;
+    int ret = !fgets(buf, len, f);
+    fclose(f);
+    buf[strcspn(buf, "\n")] = 0;
+    return ret;
+}
+
+// the first battery found, once
+void status_battery_init(status_t * st) {
+    DIR * dir = opendir("/sys/class/power_supply");
+    struct dirent * de = NULL;
+    char buf[32];
+
+    st->battery = -1;
+    if (!dir) return;
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] == '.') continue;
+        if (read_sysfs_line(de->d_name, "type", buf, sizeof(buf)) ||
+            strcmp(buf, "Battery")) continue;
+        if (read_sysfs_line(de->d_name, "capacity", buf, sizeof(buf)))
+            continue;
+        st->battery = atoi(buf);
+        if (!read_sysfs_line(de->d_name, "status", buf, sizeof(buf)))
+            st->charging = !strcmp(buf, "Charging");
+        snprintf(supply, sizeof(supply), "%s", de->d_name);
+        break;
+    }
+    closedir(dir);
+}
+
+// drain the uevent socket, returns STATUS_BATTERY if anything changed. Only
+// the battery shown counts, other ones are ignored.
+unsigned status_uevent_read(const int fd, status_t * st) {
+    static char buf[4096];
+    unsigned changed = 0;
+    ssize_t len = 0;
+
+    // "ACTION@DEVPATH\0KEY=VALUE\0KEY=VALUE\0..."
+    while ((len = recv(fd, buf, sizeof(buf) - 1, 0)) > 0) {
+        int capacity = -1, charging = -1, battery = 0, power_supply = 0;
+        char * p = NULL, * name = NULL;
+        buf[len] = 0;
+
+        for (p = buf; p < buf + len; p += strlen(p) + 1) {
+            if (!strcmp(p, "SUBSYSTEM=power_supply"))
+                power_supply = 1;
+            else if (!strcmp(p, "POWER_SUPPLY_TYPE=Battery"))
+                battery = 1;
+            else if (!strncmp(p, "POWER_SUPPLY_NAME=", 18))
+                name = p + 18;
+            else if (!strncmp(p, "POWER_SUPPLY_CAPACITY=", 22))
+                capacity = atoi(p + 22);
+            else if (!strncmp(p, "POWER_SUPPLY_STATUS=", 20))
+                charging = !strcmp(p + 20, "Charging");
+        }
+
+        if (!power_supply || !battery || !name || capacity < 0) continue;
+        if (!*supply) snprintf(supply, sizeof(supply), "%s", name);
+        if (strcmp(name, supply)) continue;
+        if (capacity != st->battery ||
+            (charging >= 0 && charging != st->charging)) {
+            st->battery = capacity;
+            if (charging >= 0) st->charging = charging;
+            changed = STATUS_BATTERY;
+        }
+    }
+    return changed;
+}
+
+struct status_xkb_t {
+    xcb_connection_t * conn;
+    uint8_t first_event;
+    uint8_t group;
+    char names[4][32];          // by group, looked up only when changed
+};
+
+static void xkb_group_names(status_xkb_t * x) {
+    xcb_connection_t * c = x->conn;
+    xcb_xkb_get_names_reply_t * r = xcb_xkb_get_names_reply(c,
+            xcb_xkb_get_names(c, XCB_XKB_ID_USE_CORE_KBD,
+                XCB_XKB_NAME_DETAIL_GROUP_NAMES), NULL);
+    xcb_xkb_get_names_value_list_t list;
+    xcb_get_atom_name_cookie_t cookies[4];
+    int i = 0, n = 0;
+
+    memset(x->names, 0, sizeof(x->names));
+    if (!r) return;
+    xcb_xkb_get_names_value_list_unpack(xcb_xkb_get_names_value_list(r),
+            r->nTypes, r->indicators, r->virtualMods, r->groupNames,
+            r->nKeys, r->nKeyAliases, r->nRadioGroups, r->which, &list);
+
+    // one atom for each group with a name, in group order
+    for (i = 0; i < 4; i++)
+        if (r->groupNames & (1 << i))
+            cookies[i] = xcb_get_atom_name(c, list.groups[n++]);
+
+    for (i = 0; i < 4; i++) {
+        if (!(r->groupNames & (1 << i))) continue;
+        xcb_get_atom_name_reply_t * ar =
+            xcb_get_atom_name_reply(c, cookies[i], NULL);
+        if (!ar) continue;
+        snprintf(x->names[i], sizeof(x->names[i]), "%.*s",
+                xcb_get_atom_name_name_length(ar), xcb_get_atom_name_name(ar));
+        free(ar);
+    }
+    free(r);
+}
+
+static void xkb_layout(const status_xkb_t * x, status_t * st) {
+    snprintf(st->layout, sizeof(st->layout), "%s", x->names[x->group & 3]);
+}
+
+// NULL if the server has no XKB, the overlay then just has no caps lock
+// and layout
+status_xkb_t * status_xkb_init(xcb_connection_t * c, status_t * st) {
+    xcb_xkb_use_extension_reply_t * ur = xcb_xkb_use_extension_reply(c,
+            xcb_xkb_use_extension(c, XCB_XKB_MAJOR_VERSION,
+                XCB_XKB_MINOR_VERSION), NULL);
+    if (!ur || !ur->supported) {
+        free(ur);
+        return NULL;
+    }
+    free(ur);
+
+    status_xkb_t * x = calloc(1, sizeof(status_xkb_t));
+    x->conn = c;
+    x->first_event = xcb_get_extension_data(c, &xcb_xkb_id)->first_event;
+
+    // only caps lock and the layout are shown, other modifiers and buttons
+    // must not wake us up
+    const xcb_xkb_select_events_details_t details = {
+        .affectState  = XCB_XKB_STATE_PART_MODIFIER_LOCK |
+                        XCB_XKB_STATE_PART_GROUP_STATE,
+        .stateDetails = XCB_XKB_STATE_PART_MODIFIER_LOCK |
+                        XCB_XKB_STATE_PART_GROUP_STATE,
+        .affectNames  = XCB_XKB_NAME_DETAIL_GROUP_NAMES,
+        .namesDetails = XCB_XKB_NAME_DETAIL_GROUP_NAMES,
+    };
+    xcb_xkb_select_events_aux(c, XCB_XKB_ID_USE_CORE_KBD,
+            XCB_XKB_EVENT_TYPE_STATE_NOTIFY | XCB_XKB_EVENT_TYPE_NAMES_NOTIFY,
+            0, 0, 0, 0, &details);
+
+    xcb_xkb_get_state_reply_t * sr = xcb_xkb_get_state_reply(c,
+            xcb_xkb_get_state(c, XCB_XKB_ID_USE_CORE_KBD), NULL);
+    if (sr) {
+        st->caps_lock = !!(sr->lockedMods & XCB_MOD_MASK_LOCK);
+        x->group      = sr->group;
+        free(sr);
+    }
+    xkb_group_names(x);
+    xkb_layout(x, st);
+    return x;
+}
+
+void status_xkb_free(status_xkb_t * x) {
+    free(x);
+}
+
+// returns the status items changed by event, 0 if it's not ours
+unsigned status_xkb_event(status_xkb_t * x, xcb_generic_event_t * event,
+        status_t * st) {
+    if (!x || (event->response_type & 0x7f) != x->first_event) return 0;
+
+    xcb_xkb_state_notify_event_t * se = (xcb_xkb_state_notify_event_t *)event;
+    unsigned changed = 0;
+    int caps = 0;
+
+    switch (se->xkbType) {
+        case XCB_XKB_STATE_NOTIFY:
+            caps = !!(se->lockedMods & XCB_MOD_MASK_LOCK);
+            if (caps != st->caps_lock) {
+                st->caps_lock = caps;
+                changed |= STATUS_CAPS;
+            }
+            if (se->group != x->group) {
+                x->group = se->group;
+                xkb_layout(x, st);
+                changed |= STATUS_LAYOUT;
+            }
+            break;
+
+        case XCB_XKB_NAMES_NOTIFY:
+            // layouts reconfigured, rare enough for a round trip
+            xkb_group_names(x);
+            xkb_layout(x, st);
+            changed |= STATUS_LAYOUT;
+            break;
+    }
+    return changed;
+}
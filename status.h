@@ -0,0 +1,36 @@
+#ifndef __STATUS_H__
+#define __STATUS_H__
+
+#include <xcb/xcb.h>
+
+// status overlay items, as a mask of what changed
+enum status_item_t {
+    STATUS_CAPS    = 1 << 0,
+    STATUS_LAYOUT  = 1 << 1,
+    STATUS_BATTERY = 1 << 2,
+    STATUS_ALL     = (1 << 3) - 1,
+};
+
+#define STATUS_ITEMS 3
+
+typedef struct {
+    int caps_lock;
+    char layout[32];            // keyboard layout, "" for unknown
+    int battery;                // in percent, -1 for no battery
+    int charging;
+} status_t;
+
+// power_supply uevents from the kernel
+int status_uevent_open(void);
+void status_battery_init(status_t * st);
+unsigned status_uevent_read(const int fd, status_t * st);
+
+// XKB state of one display
+typedef struct status_xkb_t status_xkb_t;
+
+status_xkb_t * status_xkb_init(xcb_connection_t * c, status_t * st);
+void status_xkb_free(status_xkb_t * x);
+unsigned status_xkb_event(status_xkb_t * x, xcb_generic_event_t * event,
+        status_t * st);
+
+#endif
@@ -0,0 +1,264 @@
+// kill() and friends are not in c99
+#define _XOPEN_SOURCE 500
+
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <xcb/xcb.h>
+
+#include "supervisor.h"
+#include "metrics.h"
+
+// The locker runs as a child of a tiny supervisor. The supervisor keeps
+// its own connection to every display, with a cover window per screen
+// created up front but left unmapped. Should the locker die on anything but
+// a successful unlock, its windows and grabs go away with its connection.
+// Once waitpid() returns, the supervisor maps the covers, grabs input, and
+// starts a new locker.
+//
+// A new locker maps its own windows first, then tells the supervisor over
+// a pipe, which lets go of its grabs, so the locker can take them.
+//
+// A display whose server went away is no longer covered, and left out of
+// new lockers, which would only die on it. Once no display is left, there
+// is nothing to protect.
+
+typedef struct {
+    const char * name;          // NULL for $DISPLAY
+    xcb_connection_t * conn;
+    int ns;
+    xcb_window_t * covers;
+    xcb_window_t * roots;
+} cover_t;
+
+static cover_t * covers = NULL;
+static int ncover = 0;
+
+// locker side of the handoff pipes, -1 without supervisor
+static int ready_fd = -1, ack_fd = -1;
+
+static volatile sig_atomic_t dump_requested = 0;
+
+static void on_sigusr1(int sig) {
+    dump_requested = 1;
+}
+
+static void cover_init(cover_t * cv, const char * name, const uint32_t color) {
+    const xcb_setup_t * setup = NULL;
+    xcb_screen_iterator_t iter;
+    int i = 0;
+
+    cv->name = name;
+    cv->conn = xcb_connect(name, NULL);
+    if (!cv->conn || xcb_connection_has_error(cv->conn)) {
+        fprintf(stderr, "supervisor: unable to open xcb connection to %s\n",
+                name? name: "$DISPLAY");
+        exit(EXIT_FAILURE);
+    }
+
+    setup      = xcb_get_setup(cv->conn);
+    cv->ns     = xcb_setup_roots_length(setup);
+    cv->covers = calloc(cv->ns, sizeof(xcb_window_t));
+    cv->roots  = calloc(cv->ns, sizeof(xcb_window_t));
+
+    iter = xcb_setup_roots_iterator(setup);
+    for (i = 0; i < cv->ns; i++, xcb_screen_next(&iter)) {
+        xcb_screen_t * s = iter.data;
+        cv->roots[i]  = s->root;
+        cv->covers[i] = xcb_generate_id(cv->conn);
+        // big enough for any screen size the root may get later
+        xcb_create_window(cv->conn, XCB_COPY_FROM_PARENT, cv->covers[i],
+                s->root, 0, 0, 0x7fff, 0x7fff, 0,
+                XCB_WINDOW_CLASS_INPUT_OUTPUT, s->root_visual,
+                XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT,
+                (uint32_t[]) { color, 1 });
+    }
+    xcb_flush(cv->conn);
+}
+
+// map and grab everything, returns non-zero if some grab failed
+static int cover_lock(cover_t * cv) {
+    xcb_connection_t * c = cv->conn;
+    xcb_grab_pointer_cookie_t  pc[cv->ns];
+    xcb_grab_keyboard_cookie_t kc[cv->ns];
+    int i = 0, retry = 1000, failed = 1;
+
+    if (xcb_connection_has_error(c)) return 1;
+    for (i = 0; i < cv->ns; i++) {
+        xcb_map_window(c, cv->covers[i]);
+        xcb_configure_window(c, cv->covers[i], XCB_CONFIG_WINDOW_STACK_MODE,
+                (uint32_t[]) { XCB_STACK_MODE_ABOVE });
+    }
+
+    // all grabs in flight at once, one round trip in the common case
+    while (failed && retry--) {
+        failed = 0;
+        for (i = 0; i < cv->ns; i++) {
+            pc[i] = xcb_grab_pointer(c, 0, cv->roots[i], XCB_NONE,
+                    XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+                    XCB_NONE, XCB_NONE, XCB_CURRENT_TIME);
+            kc[i] = xcb_grab_keyboard(c, 1, cv->roots[i], XCB_CURRENT_TIME,
+                    XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+        }
+        for (i = 0; i < cv->ns; i++) {
+            xcb_grab_pointer_reply_t  * pr =
+                xcb_grab_pointer_reply(c, pc[i], NULL);
+            xcb_grab_keyboard_reply_t * kr =
+                xcb_grab_keyboard_reply(c, kc[i], NULL);
+            failed |= !pr || pr->status != XCB_GRAB_STATUS_SUCCESS;
+            failed |= !kr || kr->status != XCB_GRAB_STATUS_SUCCESS;
+            free(pr);
+            free(kr);
+        }
+        if (xcb_connection_has_error(c)) {
+            fprintf(stderr, "supervisor: lost %s, no longer covered\n",
+                    cv->name? cv->name: "$DISPLAY");
+            return 1;
+        }
+        if (failed) usleep(100);
+    }
+    return failed;
+}
+
+// the new locker has its windows up, hand the grabs over
+static void cover_release(cover_t * cv) {
+    xcb_connection_t * c = cv->conn;
+    int i = 0;
+
+    if (xcb_connection_has_error(c)) return;
+    xcb_ungrab_pointer(c, XCB_CURRENT_TIME);
+    xcb_ungrab_keyboard(c, XCB_CURRENT_TIME);
+    for (i = 0; i < cv->ns; i++) xcb_unmap_window(c, cv->covers[i]);
+    // make sure the server is done with it before the locker grabs
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static int covers_alive(void) {
+    int i = 0, alive = 0;
+    for (i = 0; i < ncover; i++)
+        alive += !xcb_connection_has_error(covers[i].conn);
+    return alive;
+}
+
+void supervisor_run(const char ** names, const int nd, const uint32_t color) {
+    int i = 0, covered = 0;
+    struct sigaction sa;
+
+    ncover = nd;
+    covers = calloc(nd, sizeof(cover_t));
+    for (i = 0; i < nd; i++) cover_init(covers + i, names[i], color);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigusr1;
+    sigaction(SIGUSR1, &sa, NULL);
+    // a locker dying mid handoff must not take us with it
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    for (;;) {
+        int ready[2], ack[2], status = 0;
+        char b = 0;
+
+        if (pipe(ready) || pipe(ack)) {
+            perror("pipe()");
+            exit(EXIT_FAILURE);
+        }
+
+        int64_t started = metrics_now();
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork()");
+            // nothing can unlock this, but stay locked if we are
+            if (covered) pause();
+            exit(EXIT_FAILURE);
+        }
+
+        if (!pid) {
+            // the locker, the covers are none of its business
+            for (i = 0; i < ncover; i++)
+                close(xcb_get_file_descriptor(covers[i].conn));
+            close(ready[0]);
+            close(ack[1]);
+            ready_fd = ready[1];
+            ack_fd   = ack[0];
+            return;
+        }
+
+        close(ready[1]);
+        close(ack[0]);
+
+        // wait for the locker to cover the screens, EOF if it died first
+        ssize_t n = 0;
+        while ((n = read(ready[0], &b, 1)) < 0 && errno == EINTR) ;
+        if (n == 1 && covered) {
+            for (i = 0; i < ncover; i++) cover_release(covers + i);
+            covered = 0;
+        }
+        if (n == 1 && write(ack[1], &b, 1) < 0 && errno != EPIPE)
+            perror("write()");
+        close(ready[0]);
+        close(ack[1]);
+
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) {
+                perror("waitpid()");
+                break;
+            }
+            if (dump_requested) {
+                dump_requested = 0;
+                kill(pid, SIGUSR1);
+                metrics_dump();
+            }
+        }
+
+        // unlocked, the locker exits with a failure on anything else
+        if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) break;
+
+        // only our part of the gap, the kernel waking us up is not in it,
+        // bench/relock.sh times the whole gap from outside
+        int64_t died = metrics_now();
+        for (i = 0; i < ncover; i++) cover_lock(covers + i);
+        covered = 1;
+        metric_time(METRIC_RELOCK_GAP, metrics_now() - died);
+
+        if (WIFSIGNALED(status))
+            fprintf(stderr, "supervisor: locker killed by signal %d, "
+                    "relocked\n", WTERMSIG(status));
+        else
+            fprintf(stderr, "supervisor: locker exited with %d, relocked\n",
+                    WEXITSTATUS(status));
+
+        // every X server gone, nothing left to protect
+        if (!covers_alive()) exit(EXIT_FAILURE);
+
+        // don't spin when the locker can't even start
+        if (died - started < 1000 * 1000) sleep(1);
+    }
+
+    metrics_dump();
+    exit(EXIT_SUCCESS);
+}
+
+// locker: non-zero if the server of a display went away, as far as the
+// supervisor saw before starting us
+int supervisor_gone(const int display) {
+    return covers && xcb_connection_has_error(covers[display].conn);
+}
+
+// locker: windows are mapped, take over the grabs from the supervisor
+void supervisor_handoff(void) {
+    char b = 'r';
+    if (ready_fd < 0) return;
+
+    if (write(ready_fd, &b, 1) == 1)
+        while (read(ack_fd, &b, 1) < 0 && errno == EINTR) ;
+    close(ready_fd);
+    close(ack_fd);
+    ready_fd = ack_fd = -1;
+}
@@ -0,0 +1,10 @@
+#ifndef __SUPERVISOR_H__
+#define __SUPERVISOR_H__
+
+#include <stdint.h>
+
+void supervisor_run(const char ** names, const int nd, const uint32_t color);
+void supervisor_handoff(void);
+int supervisor_gone(const int display);
+
+#endif
@@ -13,6 +13,7 @@ struct wtimer_t {
     enum wtimer_type_t type;
     enum { wt_suspend = 0, wt_running = 1 } status;
     wtimer_cb cb;
+    void * data;
     struct timeval started;
     struct wtimer_t * next;
 };
@@ -119,6 +120,23 @@ void wtimer_rearm(wtimer_t * t, const uint64_t to, wtimer_cb cb) {
     gettimeofday(&t->started, NULL);
 }
 
+void wtimer_suspend(wtimer_t * t) {
+    t->status = wt_suspend;
+}
+
+int wtimer_running(const wtimer_t * t) {
+    return t->status == wt_running;
+}
+
+// attach caller's context to a timer, so one callback can serve many timers
+void wtimer_set_data(wtimer_t * t, void * data) {
+    t->data = data;
+}
+
+void * wtimer_data(const wtimer_t * t) {
+    return t->data;
+}
+
 void wtimer_list_stop(wtimer_list_t * tl) {
     tl->status = tl_pause;
 }
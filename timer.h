@@ -29,6 +29,10 @@ int64_t wtimer_list_next_timeout(
         wtimer_list_t * tl, const struct timeval * now);
 int wtimer_list_timeout(wtimer_list_t * tl, const struct timeval * now);
 void wtimer_rearm(wtimer_t * t, const uint64_t to, wtimer_cb cb);
+void wtimer_suspend(wtimer_t * t);
+int wtimer_running(const wtimer_t * t);
+void wtimer_set_data(wtimer_t * t, void * data);
+void * wtimer_data(const wtimer_t * t);
 void wtimer_list_stop(wtimer_list_t * tl);
 void wtimer_list_start(wtimer_list_t * tl);
 
@@ -3,15 +3,20 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/mman.h>
 #include <sys/epoll.h>
+#include <sys/resource.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_keysyms.h>
+#include <xcb/randr.h>
 
 // since xcb dosen't X11/keysym.h eqvalient, for now, we needs this X11 header
 #include <X11/keysym.h>
@@ -30,19 +35,58 @@
 
 #include "lock_screen.h"
 #include "timer.h"
-
-// global variables
-static char * pass_input = NULL;
-static xcb_connection_t * xcb_conn = NULL;
+#include "config.h"
+#include "metrics.h"
+#include "render.h"
+#include "supervisor.h"
+#include "autolock.h"
+#include "alloc.h"
 
 typedef struct {
     xcb_window_t lock_window;
     xcb_screen_t * screen;
+    uint16_t width, height;     // size the window was created with
+    // dropped on a full render queue, see push()
+    int resized;                // newest size not handed over yet
+    uint16_t new_width, new_height;
+    int64_t resize_seen;
+    int damaged;                // exposes not handed over yet, merged
+    int16_t x1, y1, x2, y2;
 } lock_t;
 
-static lock_t * locks = NULL;
-static int ns;
-static int  pass_pos = 0;
+// everything we keep for one X display, one display may have many screens
+typedef struct {
+    const char * name;          // NULL for $DISPLAY
+    xcb_connection_t * conn;
+    xcb_key_symbols_t * ksyms;
+    lock_t * locks;
+    int ns;
+    char * pass_input;          // points into the shared mlock()ed area
+    int pass_pos;
+    wtimer_t * pass_wrong_timer;
+    int showing_error;
+    int resync;                 // commands were lost, see push()
+    int randr_event;            // first RandR event, -1 without RandR
+} display_t;
+
+// global variables
+static display_t * displays = NULL;
+static int nd = 0;
+static plan_t * plan = NULL;
+// everything drawn is drawn by the render thread
+static render_t * render = NULL;
+
+// --resident: warm up, then keep everything in memory and out of OOM's way
+static int resident = 0;
+// --priority: raise scheduling priority of the input path
+static int raise_priority = 0;
+// what it got: 0 nothing yet, 1 realtime, 2 nice, -1 not allowed
+static int input_prio = 0;
+static int input_nice = 0;      // nice level to go back to
+// --auto[=SECONDS]: stay around, and lock whenever the user goes idle
+static int auto_lock = 0, auto_timeout = 0;
+
+#define foreach_display(d) for ((d) = displays; (d) < displays + nd; (d)++)
 
 #if !defined(NO_DPMS)
 static void dpms_off(xcb_connection_t * c) {
@@ -102,17 +146,24 @@ static int check_pass(const char * p1, const char * p2) {
 #else
 static pam_handle_t * pamh = NULL;
 static char * username = NULL;
+// password being checked, one PAM handle is shared by all displays
+static const char * auth_input = NULL;
 
 static int pam_conv_func(int nmsg, const struct pam_message ** msg,
         struct pam_response ** resp, void * data) {
     int i = 0;
-    *resp = calloc(nmsg, sizeof(struct pam_response));
+    size_t len = strlen(auth_input) + 1;
+
+    // PAM frees the replies, so they must come from malloc(), but they need
+    // not be any bigger than the password
+    if (!(*resp = calloc(nmsg, sizeof(struct pam_response))))
+        return PAM_BUF_ERR;
 
     for (i = 0; i < nmsg; i++) {
         if (msg[i]->msg_style == PAM_PROMPT_ECHO_OFF ||
             msg[i]->msg_style == PAM_PROMPT_ECHO_ON) {
-            (*resp)[i].resp = calloc(MAX_PASSLEN, sizeof(char));
-            strcpy((*resp)[i].resp, pass_input);
+            if (!((*resp)[i].resp = malloc(len))) return PAM_BUF_ERR;
+            memcpy((*resp)[i].resp, auth_input, len);
         }
     }
 
@@ -121,14 +172,21 @@ static int pam_conv_func(int nmsg, const struct pam_message ** msg,
 
 static struct pam_conv pam_conv = {pam_conv_func, NULL};
 
-static int check_pass() {
-    return pam_authenticate(pamh, 0) == PAM_SUCCESS? 0: 1;
+static int check_pass(const char * input) {
+    auth_input = input;
+    // PAM allocates as it likes, and frees what we hand it
+    alloc_exempt(1);
+    int ret = pam_authenticate(pamh, 0) == PAM_SUCCESS? 0: 1;
+    alloc_exempt(0);
+    auth_input = NULL;
+    return ret;
 }
 
 #endif /* NO_PAM */
 
-static void lock(xcb_connection_t * c);
-static void read_passwd(xcb_connection_t * c, const char * passwd);
+static void lock(display_t * d);
+static void grab(display_t * d);
+static int read_passwd(const char * passwd);
 
 // this function is stolen from i3lock, with some modification
 static void clear_memory(char * p, const size_t s) {
@@ -143,8 +201,118 @@ static void clear_memory(char * p, const size_t s) {
 #endif
 }
 
+#define OOM_SCORE_ADJ "-1000"
+
+// a killed locker is an unlocked session, this needs CAP_SYS_RESOURCE
+static void lower_oom_score(void) {
+    FILE * f = fopen("/proc/self/oom_score_adj", "w");
+    int err = !f;
+
+    if (f) {
+        err = fputs(OOM_SCORE_ADJ, f) < 0;
+        err = fclose(f) || err;
+    }
+    if (err) {
+        perror("oom_score_adj");
+        fprintf(stderr, "Cannot lower OOM score, going on anyway\n");
+    }
+}
+
+// raise a soft limit to at least want, and the hard one if we may
+static void raise_limit(const int resource, const rlim_t want) {
+    struct rlimit rl;
+    if (getrlimit(resource, &rl) || rl.rlim_cur >= want) return;
+    rl.rlim_cur = want;
+    if (rl.rlim_max < want) rl.rlim_max = want;
+    setrlimit(resource, &rl);
+}
+
+// while we may still be root: only the input thread of the locker takes
+// the priority, long after root is dropped, so allow it to
+static void allow_input_priority(void) {
+    raise_limit(RLIMIT_RTPRIO, sched_get_priority_min(SCHED_FIFO));
+    // nice may go down to 20 - RLIMIT_NICE
+    raise_limit(RLIMIT_NICE, 30);
+}
+
+// raise or drop the priority of the calling thread, the one reading input.
+// The supervisor, the --auto watcher and the render thread keep theirs, and
+// the priority is dropped while PAM hashes a password.
+static void input_priority(const int on) {
+    struct sched_param sp = { .sched_priority = 0 };
+
+    if (!raise_priority || input_prio < 0) return;
+    if (!on) {
+        if (input_prio == 1)
+            pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+        else if (input_prio == 2)
+            setpriority(PRIO_PROCESS, 0, input_nice);
+        input_prio = 0;
+        return;
+    }
+
+    // realtime if we are allowed to, we only run when there is input
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (!pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp)) {
+        input_prio = 1;
+        return;
+    }
+    // on Linux, nice is per thread
+    input_nice = getpriority(PRIO_PROCESS, 0);
+    if (!setpriority(PRIO_PROCESS, 0, -10)) {
+        input_prio = 2;
+        return;
+    }
+    perror("setpriority()");
+    fprintf(stderr, "Cannot raise priority, going on anyway\n");
+    input_prio = -1;
+}
+
+// pin everything in memory, including whatever gets allocated later, like
+// the render thread warming up the screens
+static void go_resident(void) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        perror("mlockall()");
+        fprintf(stderr, "Cannot lock everything in memory, "
+                "please check RLIMIT_MEMLOCK\n");
+    }
+}
+
+// SIGUSR1 dumps the metrics of a running locker
+static volatile sig_atomic_t dump_requested = 0;
+
+static void on_sigusr1(int sig) {
+    dump_requested = 1;
+}
+
+static void usage(void) {
+    die("usage: wslock [--resident] [--priority] [--auto[=SECONDS]] "
+        "[display ...]\n");
+}
+
 int main(const int argc, const char * argv[]) {
-    int ret = 0;
+    int ret = 0, i = 0, n = 0, unlocked = 0;
+
+    // displays to lock are given on command line, default to $DISPLAY
+    displays = calloc(argc, sizeof(display_t));
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--resident"))      resident = 1;
+        else if (!strcmp(argv[i], "--priority")) raise_priority = 1;
+        else if (!strcmp(argv[i], "--auto"))     auto_lock = 1;
+        else if (!strncmp(argv[i], "--auto=", 7)) {
+            auto_lock = 1;
+            // the server keeps it in 16 bits
+            auto_timeout = atoi(argv[i] + 7);
+            if (auto_timeout <= 0 || auto_timeout > 32767) usage();
+        }
+        else if (argv[i][0] == '-')              usage();
+        else displays[nd++].name = argv[i];
+    }
+    if (!nd) nd = 1;
+
+    // while we may still be root
+    if (resident) lower_oom_score();
+    if (raise_priority) allow_input_priority();
 
 #if !defined(USE_PAM)
     char * user_pass = calloc(MAX_PASSLEN, sizeof(char));
@@ -164,7 +332,28 @@ int main(const int argc, const char * argv[]) {
         die("Cannot drop root privileges"
             "I'll just die here before doing anything.\n");
     }
-#else // init PAM
+#endif
+
+    const char * names[nd];
+    for (i = 0; i < nd; i++) names[i] = displays[i].name;
+
+    // --auto: wait for the user to go idle, then go on as a fresh locker
+    if (auto_lock) autolock_run(names, nd, auto_timeout);
+
+    // theme and layouts, mostly straight from cache
+    plan = plan_load();
+    lock_screen_init(plan);
+
+    // from here on we are the locker, restarted by the supervisor should we
+    // ever die before the user unlocks
+    supervisor_run(names, nd, plan_theme(plan)->color_lock);
+
+    // displays whose server went away while we were down stay left out
+    for (i = 0, n = 0; i < nd; i++)
+        if (!supervisor_gone(i)) displays[n++] = displays[i];
+    nd = n;
+
+#if defined(USE_PAM) // init PAM
     username = getenv("USER");
     if ((ret = pam_start("wslock-password", username, &pam_conv, &pamh))
                 != PAM_SUCCESS) {
@@ -174,41 +363,61 @@ int main(const int argc, const char * argv[]) {
 #endif
 
     // init xcb connections
-    xcb_conn = xcb_connect(NULL, NULL);
-    if(!xcb_conn || xcb_connection_has_error(xcb_conn))
-        die("unable to open xcb connection, just die here\n");
+    display_t * d = NULL;
+    foreach_display(d) {
+        d->conn = xcb_connect(d->name, NULL);
+        if(!d->conn || xcb_connection_has_error(d->conn))
+            die("unable to open xcb connection to %s, just die here\n",
+                    d->name? d->name: "$DISPLAY");
+
+        d->ns = xcb_setup_roots_length(xcb_get_setup(d->conn));
+        d->locks = calloc(d->ns, sizeof(lock_t));
+    }
 
-    ns = xcb_setup_roots_length(xcb_get_setup(xcb_conn));
-    locks = calloc(ns, sizeof(lock_t));
+    // cover everything, every display
+    foreach_display(d) {
+        lock(d);
+        // make sure we have everything synced.
+        xcb_flush(d->conn);
+    }
 
-    // lock everything
-    lock(xcb_conn);
+    // then take the grabs, from the supervisor if it is holding them
+    supervisor_handoff();
+    foreach_display(d) {
+        grab(d);
 
 #if !defined(NO_DPMS)
-    dpms_off(xcb_conn);
+        dpms_off(d->conn);
 #endif
 
-    // make sure we have everything synced.
-    xcb_flush(xcb_conn);
+        xcb_flush(d->conn);
+    }
 
     // read password, blocked till we should unlock
 #if defined(USE_PAM)
-    read_passwd(xcb_conn, NULL);
+    unlocked = read_passwd(NULL);
 #else
-    read_passwd(xcb_conn, user_pass);
+    unlocked = read_passwd(user_pass);
 #endif
 
     // free everything
-    xcb_disconnect(xcb_conn);
+    foreach_display(d) {
+        xcb_disconnect(d->conn);
+        free(d->locks);
+    }
 #if !defined(USE_PAM)
     clear_memory(user_pass, MAX_PASSLEN);
     free(user_pass);
 #else
     pam_end(pamh, 0);
 #endif
-    free(locks);
+    lock_screen_free_cache();
+    plan_free(plan);
+    free(displays);
+    metrics_dump();
 
-    return 0;
+    // anything but an unlock has the supervisor lock again
+    return unlocked? EXIT_SUCCESS: EXIT_FAILURE;
 }
 
 static void set_window_ontop(xcb_connection_t * c, xcb_window_t w) {
@@ -222,14 +431,21 @@ static void set_window_ontop(xcb_connection_t * c, xcb_window_t w) {
 }
 
 static xcb_window_t new_fullscreen_window(xcb_connection_t * c,
-        xcb_screen_t * s, const uint32_t color) {
+        xcb_screen_t * s, const uint16_t width, const uint16_t height,
+        const uint32_t color) {
     uint32_t mask = 0;
     uint32_t values[3];
 
     xcb_window_t win = xcb_generate_id(c);
 
+#if !defined(NO_FADE)
+    // whatever is on screen stays there till the render thread fades in
+    mask |= XCB_CW_BACK_PIXMAP;
+    values[0] = XCB_BACK_PIXMAP_NONE;
+#else
     mask |= XCB_CW_BACK_PIXEL;
     values[0] = color;
+#endif
 
     mask |= XCB_CW_OVERRIDE_REDIRECT;
     values[1] = 1;
@@ -243,7 +459,7 @@ static xcb_window_t new_fullscreen_window(xcb_connection_t * c,
 
     xcb_create_window(
             c, XCB_COPY_FROM_PARENT, win, s->root,
-            0, 0, s->width_in_pixels, s->height_in_pixels, 0,
+            0, 0, width, height, 0,
             XCB_WINDOW_CLASS_INPUT_OUTPUT,
             s->root_visual,
             mask, values);
@@ -288,27 +504,70 @@ static void grab_everything_excpt_mediakey(
     }
 }
 
-static void lock(xcb_connection_t * c) {
+// ask for screen size changes through RandR, ConfigureNotify on the roots
+// is what we have without it. Roots are known, windows not made yet.
+static void select_randr(display_t * d) {
+    xcb_connection_t * c = d->conn;
+    xcb_randr_query_version_reply_t * r = xcb_randr_query_version_reply(c,
+            xcb_randr_query_version(c, XCB_RANDR_MAJOR_VERSION,
+                XCB_RANDR_MINOR_VERSION), NULL);
+    int i = 0;
+
+    d->randr_event = -1;
+    if (!r) return;
+    free(r);
+
+    d->randr_event = xcb_get_extension_data(c, &xcb_randr_id)->first_event;
+    for (i = 0; i < d->ns; i++)
+        xcb_randr_select_input(c, d->locks[i].screen->root,
+                XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE);
+}
+
+static void lock(display_t * d) {
     // lock each screen, one by one
+    xcb_connection_t * c = d->conn;
     const xcb_setup_t * xcb_setup = xcb_get_setup(c);
     xcb_screen_iterator_t iter  = xcb_setup_roots_iterator(xcb_setup);
+    xcb_get_geometry_cookie_t gc[d->ns];
     int i = 0;
 
-    // iterate through screens
-    for (i = 0; i < ns; i++) {
+    // size changes first, so none is missed from here on
+    for (i = 0; i < d->ns; i++, xcb_screen_next(&iter)) {
         xcb_screen_t * s = iter.data;
         xcb_change_window_attributes(c, s->root, XCB_CW_EVENT_MASK,
                 (uint32_t[]) { XCB_EVENT_MASK_STRUCTURE_NOTIFY });
-
-        locks[i].lock_window = new_fullscreen_window(c, s, COLOR_LOCK);
-        locks[i].screen      = s;
-        grab_everything_excpt_mediakey(c, s);
-        xcb_screen_next(&iter);
+        d->locks[i].screen = s;
     }
+    select_randr(d);
+
+    // then the sizes, which may have changed since the setup was read
+    for (i = 0; i < d->ns; i++)
+        gc[i] = xcb_get_geometry(c, d->locks[i].screen->root);
+    for (i = 0; i < d->ns; i++) {
+        lock_t * l = d->locks + i;
+        xcb_get_geometry_reply_t * g = xcb_get_geometry_reply(c, gc[i], NULL);
+
+        l->width  = g? g->width:  l->screen->width_in_pixels;
+        l->height = g? g->height: l->screen->height_in_pixels;
+        free(g);
+        l->lock_window = new_fullscreen_window(c, l->screen,
+                l->width, l->height, plan_theme(plan)->color_lock);
+    }
+}
+
+// after lock(), and after the supervisor let go of its grabs
+static void grab(display_t * d) {
+    int i = 0;
+    for (i = 0; i < d->ns; i++)
+        grab_everything_excpt_mediakey(d->conn, d->locks[i].screen);
 }
 
+// one idle timer for all displays
 void idle_cb(wtimer_t * t, const struct timeval * now) {
-    dpms_off(xcb_conn);
+#if !defined(NO_DPMS)
+    display_t * d = NULL;
+    foreach_display(d) dpms_off(d->conn);
+#endif
 }
 
 // state for check password state
@@ -352,12 +611,14 @@ static int deal_with_key_press(
         case XK_Return:
         case XK_KP_Enter:
             pass_input[*pos] = 0;
+            input_priority(0);
 #if defined(USE_PAM)
-            ret = check_pass()? pass_auth_fail: pass_auth_succ;
+            ret = check_pass(pass_input)? pass_auth_fail: pass_auth_succ;
 #else
             ret = check_pass(pass_input, pass_sys)? pass_auth_fail
                                                   : pass_auth_succ;
 #endif
+            input_priority(1);
             *pos = 0;
             break;
         case XK_BackSpace:
@@ -374,147 +635,348 @@ static int deal_with_key_press(
     return ret;
 }
 
-wtimer_t * pass_wrong_timer = NULL;
+// a command the render thread could not take. The state is resent whole
+// anyway, the newest size and all damage are kept per screen.
+static void keep_lost(display_t * d, const render_cmd_t * cmd) {
+    int16_t x2 = cmd->x + cmd->width, y2 = cmd->y + cmd->height;
+    lock_t * l = NULL;
+
+    d->resync = 1;
+    if (cmd->type != RENDER_RESIZE && cmd->type != RENDER_EXPOSE) return;
+    if (cmd->screen >= d->ns) return;
+    l = d->locks + cmd->screen;
+
+    if (cmd->type == RENDER_RESIZE) {
+        if (!l->resized) l->resize_seen = cmd->seen;
+        l->resized    = 1;
+        l->new_width  = cmd->width;
+        l->new_height = cmd->height;
+    } else if (!l->damaged) {
+        l->x1 = cmd->x;
+        l->y1 = cmd->y;
+        l->x2 = x2;
+        l->y2 = y2;
+        l->damaged = 1;
+    } else {
+        if (cmd->x < l->x1) l->x1 = cmd->x;
+        if (cmd->y < l->y1) l->y1 = cmd->y;
+        if (x2 > l->x2) l->x2 = x2;
+        if (y2 > l->y2) l->y2 = y2;
+    }
+}
+
+// hand over what was lost, returns 0 while the queue is still full
+static int resync(display_t * d, const int64_t seen) {
+    render_cmd_t cmd = {
+        .type = RENDER_STATE, .display = d - displays,
+        .error = d->showing_error, .len = d->pass_pos, .seen = seen,
+    };
+    int i = 0;
+
+    if (!d->resync) return 1;
+    if (!render_push(render, &cmd)) return 0;
+    for (i = 0; i < d->ns; i++) {
+        lock_t * l = d->locks + i;
+        if (l->resized) {
+            cmd = (render_cmd_t) { .type = RENDER_RESIZE,
+                .display = d - displays, .screen = i, .width = l->new_width,
+                .height = l->new_height, .seen = l->resize_seen };
+            if (!render_push(render, &cmd)) return 0;
+            l->resized = 0;
+        }
+        if (l->damaged) {
+            cmd = (render_cmd_t) { .type = RENDER_EXPOSE,
+                .display = d - displays, .screen = i, .x = l->x1, .y = l->y1,
+                .width = l->x2 - l->x1, .height = l->y2 - l->y1,
+                .seen = seen };
+            if (!render_push(render, &cmd)) return 0;
+            l->damaged = 0;
+        }
+    }
+    d->resync = 0;
+    return 1;
+}
+
+// hand a command to the render thread. A full queue means the render
+// thread is stuck: what it missed is kept, and handed over by the main
+// loop once there is room, before anything newer.
+static void push(display_t * d, render_cmd_t cmd, const int64_t seen) {
+    cmd.display = d - displays;
+    cmd.seen    = seen;
+
+    if (!resync(d, seen) || !render_push(render, &cmd)) keep_lost(d, &cmd);
+}
 
 static void pass_wrong_cb(wtimer_t * t, const struct timeval * now) {
+    display_t * d = wtimer_data(t);
+    d->showing_error = 0;
+    push(d, (render_cmd_t) { .type = RENDER_STATE, .len = d->pass_pos },
+            metrics_now());
+}
+
+static int screen_of(const display_t * d, const xcb_window_t w) {
     int i = 0;
-    for (i = 0; i < ns; i++)
-        lock_screen_input(xcb_conn, locks[i].screen, locks[i].lock_window, pass_pos);
-    xcb_flush(xcb_conn);
+    for (i = 0; i < d->ns; i++)
+        if (d->locks[i].screen->root == w || d->locks[i].lock_window == w)
+            return i;
+    return -1;
+}
+
+// a root changed size, monitor docked or undocked. The render thread
+// resizes the lock window in place, grabs stay where they are.
+static void resize_lock(display_t * d, const xcb_window_t root,
+        const uint16_t width, const uint16_t height, const int64_t woken) {
+    int i = screen_of(d, root);
+    if (i < 0 || d->locks[i].screen->root != root) return;
+    push(d, (render_cmd_t) { .type = RENDER_RESIZE, .screen = i,
+            .width = width, .height = height }, woken);
+}
+
+// drain all pending events of one display, returns non-zero when unlocked.
+// woken: when the loop saw the events, for latency metrics
+static int handle_display_events(display_t * d, const char * pass,
+        const int64_t woken) {
+    xcb_connection_t * c = d->conn;
+    xcb_generic_event_t * event;
+    int unlock = 0;
+    int64_t allocs = 0;
+
+    while ((event = alloc_poll_event(c))) {
+        if (!event->response_type) goto next_event;
+        int type = (event->response_type & 0x7f);
+        int i = 0, ret = 0;
+
+        if (d->randr_event >= 0 &&
+            type == d->randr_event + XCB_RANDR_SCREEN_CHANGE_NOTIFY) {
+            xcb_randr_screen_change_notify_event_t * e =
+                (xcb_randr_screen_change_notify_event_t *)event;
+            // the size is given unrotated, a portrait output swaps it
+            if (e->rotation & (XCB_RANDR_ROTATION_ROTATE_90 |
+                               XCB_RANDR_ROTATION_ROTATE_270))
+                resize_lock(d, e->root, e->height, e->width, woken);
+            else
+                resize_lock(d, e->root, e->width, e->height, woken);
+            goto next_event;
+        }
+
+#define foreach_screen for (i = 0; i < d->ns; i++)
+        switch (type) {
+            case XCB_EXPOSE: {
+                xcb_expose_event_t * e = (xcb_expose_event_t *)event;
+                if ((i = screen_of(d, e->window)) < 0) break;
+                push(d, (render_cmd_t) { .type = RENDER_EXPOSE, .screen = i,
+                        .x = e->x, .y = e->y,
+                        .width = e->width, .height = e->height }, woken);
+                break;
+            }
+
+            case XCB_CONFIGURE_NOTIFY:
+                // RandR reports the same change, only roots matter here,
+                // the lock windows are ours
+                if (d->randr_event >= 0) break;
+                resize_lock(d, ((xcb_configure_notify_event_t *)event)->window,
+                        ((xcb_configure_notify_event_t *)event)->width,
+                        ((xcb_configure_notify_event_t *)event)->height, woken);
+                break;
+
+            case XCB_CIRCULATE_NOTIFY:
+                // this shouldn't be happening...
+                // unless some window sets itself on-top of the stack
+                foreach_screen
+                    set_window_ontop(c, d->locks[i].lock_window);
+                break;
+
+            case XCB_KEY_PRESS:
+                allocs = alloc_count();
+                ret = deal_with_key_press(
+                        (xcb_key_press_event_t *)event, d->ksyms,
+                        d->pass_input, &d->pass_pos, pass);
+
+                switch (ret) {
+                    case pass_auth_succ:
+                        unlock = 1;
+                        break;
+
+                    case pass_auth_fail:
+                        d->showing_error = 1;
+                        push(d, (render_cmd_t) { .type = RENDER_STATE,
+                                .error = 1 }, woken);
+                        // reset pass_wrong timer
+                        wtimer_rearm(d->pass_wrong_timer, 0, NULL);
+                        break;
+
+                    case pass_not_check:
+                        d->showing_error = 0;
+                        push(d, (render_cmd_t) { .type = RENDER_LEN,
+                                .len = d->pass_pos }, woken);
+                        break;
+                }
+                alloc_metric(METRIC_ALLOC_KEY, allocs);
+                break;
+
+            default: break;
+        }
+#undef foreach_screen
+next_event:
+        xcb_flush(c);
+        free(event);
+    }
+
+    return unlock;
 }
 
 #define Sec (1000 * 1000)
-static void read_passwd(xcb_connection_t * c, const char * pass) {
-    // init mainloop timers
+// returns non-zero when unlocked, 0 when a display or epoll was lost
+static int read_passwd(const char * pass) {
+    display_t * d = NULL;
+
+    // init mainloop timers, idle timer is shared by all displays
     wtimer_list_t * tl = wtimer_list_new(0);
     wtimer_t * idle_timer = wtimer_new(5 * Sec, idle_cb,
             WTIMER_TYPE_REPEAT, WTIMER_OP_DEFAULT);
     wtimer_add(tl, idle_timer);
-    pass_wrong_timer = wtimer_new(3 * Sec, pass_wrong_cb,
-            WTIMER_TYPE_ONESHOT, WTIMER_OP_INITSUSPEND);
-    wtimer_add(tl, pass_wrong_timer);
+    foreach_display(d) {
+        d->pass_wrong_timer = wtimer_new(3 * Sec, pass_wrong_cb,
+                WTIMER_TYPE_ONESHOT, WTIMER_OP_INITSUSPEND);
+        wtimer_set_data(d->pass_wrong_timer, d);
+        wtimer_add(tl, d->pass_wrong_timer);
+    }
 
-    // init keysym
-    xcb_key_symbols_t * ksyms = xcb_key_symbols_alloc(c);
+    // init keysym, with the keyboard mapping fetched now rather than on the
+    // first keystroke
+    foreach_display(d) {
+        d->ksyms = xcb_key_symbols_alloc(d->conn);
+        xcb_key_symbols_get_keysym(d->ksyms,
+                xcb_get_setup(d->conn)->min_keycode, 0);
+    }
 
-    // init epoll on xcb connection fd
-    struct epoll_event ev;
+    // init epoll on every xcb connection fd
+    struct epoll_event ev, * evs = calloc(nd, sizeof(struct epoll_event));
     int epoll_fd = epoll_create(1); // size not used in kernel, 1 is fine
-    int xcb_fd   = xcb_get_file_descriptor(c);
 
     if (epoll_fd < 0) {
         perror("epoll_create()");
         die("epoll fail, fd limit?\n");
     }
 
-    ev.events  = EPOLLIN;
-    ev.data.fd = xcb_fd;
+    foreach_display(d) {
+        ev.events   = EPOLLIN;
+        ev.data.ptr = d;
 
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, xcb_fd, &ev) < 0) {
-        perror("epoll_ctl()");
-        die("epoll failed\n");
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD,
+                    xcb_get_file_descriptor(d->conn), &ev) < 0) {
+            perror("epoll_ctl()");
+            die("epoll failed\n");
+        }
     }
 
-    // prepare memory to store user input
-    pass_input = calloc(MAX_PASSLEN, sizeof(char));
+    // prepare memory to store user input, one slot for each display
+    char * pass_area = calloc(nd * MAX_PASSLEN, sizeof(char));
     // user input in plain text, should prevent it from being swapped to disk
-    if (mlock(pass_input, sizeof(char) * MAX_PASSLEN)) {
+    if (mlock(pass_area, sizeof(char) * nd * MAX_PASSLEN)) {
         perror("mlock()");
         die("Cannot set mlock, please check RLIMIT_MEMLOCK\n");
     }
+    foreach_display(d) d->pass_input = pass_area + (d - displays) * MAX_PASSLEN;
 
     // the main loop
-    struct timeval * now = calloc(1, sizeof(struct timeval));
-    int64_t to  = -1;
-    int     nev = 0, ntimer = 0;
+    struct timeval now;
+    int64_t to  = -1, allocs = 0;
+    int     nev = 0, ntimer = 0, i = 0, err = 0, behind = 0;
+
+    // the grabs made sure the server knows our windows by now, the render
+    // thread can draw on them from its own connections
+    const char * names[nd];
+    foreach_display(d) names[d - displays] = d->name;
+    render = render_new(names, nd, plan_theme(plan)->frame_budget);
+    foreach_display(d)
+        for (i = 0; i < d->ns; i++)
+            render_window(render, d - displays, i, d->locks[i].lock_window,
+                    d->locks[i].width, d->locks[i].height);
+    render_start(render, resident);
+
+    // the render thread runs, nothing inherits this from here on
+    input_priority(1);
+    if (resident) go_resident();
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigusr1;
+    sigaction(SIGUSR1, &sa, NULL);
 
     // start timer
     wtimer_list_start(tl);
 
-    int exit_now = 0;
+    int exit_now = 0, unlocked = 0;
     while (!exit_now) {
-        gettimeofday(now, NULL);
-
-        to = wtimer_list_next_timeout(tl, now); // how long shall we wait
-
-        if (to > 0) to /= 1000;
-        errno = 0;
-        nev = epoll_wait(epoll_fd, &ev, 1, to); // then we will wait
-        switch (errno) {
-            case EBADF:
-            case EINVAL:
-                // fd to xcb connection became unusable, maybe X crashed
-                // we should exit now.
-                perror("Cannot perform epoll on xcb connection fd, "
-                       "Maybe X just crashed. epoll_wait()");
-                exit_now = 1;
-            case EINTR:
-                // just epoll again
-                continue;
-            default: break;
+        allocs = alloc_count();
+        gettimeofday(&now, NULL);
+
+        to = wtimer_list_next_timeout(tl, &now); // how long shall we wait
+
+        // round up, waking before the timer is due only spins the loop
+        if (to > 0) to = (to + 999) / 1000;
+
+        // the render thread fell behind, retry soon rather than on the
+        // next event, which may be long
+        behind = 0;
+        foreach_display(d) behind |= !resync(d, metrics_now());
+        if (behind && (to < 0 || to > 1)) to = 1;
+        nev = epoll_wait(epoll_fd, evs, nd, to); // then we will wait
+        err = nev < 0? errno: 0;
+        if (dump_requested) {
+            // metrics are kept by the render thread
+            dump_requested = 0;
+            render_push(render, &(render_cmd_t) { .type = RENDER_DUMP });
+        }
+        // just epoll again
+        if (err == EINTR) continue;
+        if (err) {
+            // epoll fd itself became unusable, we should exit now, and
+            // be restarted by the supervisor
+            errno = err;
+            perror("Cannot perform epoll on xcb connection fds. "
+                   "epoll_wait()");
+            break;
         }
 
         // check and trigger timeouts
-        ntimer = wtimer_list_timeout(tl, now);
+        ntimer = wtimer_list_timeout(tl, &now);
         if (ntimer)
             ;
 
-        if (nev) { // we got xcb events
-            xcb_generic_event_t * event;
-            while ((event = xcb_poll_for_event(c))) {
-                if (!event->response_type) goto next_event;
-                int type = (event->response_type & 0x7f);
-                int i = 0, ret = 0;
-
-#define foreach_screen for (i = 0; i < ns; i++)
-                switch (type) {
-                    case XCB_CIRCULATE_NOTIFY:
-                        // this shouldn't be happening...
-                        // unless some window sets itself on-top of the stack
-                        foreach_screen
-                            set_window_ontop(c, locks[i].lock_window);
-                        break;
-
-                    case XCB_KEY_PRESS:
-                        ret = deal_with_key_press(
-                                (xcb_key_press_event_t *)event, ksyms,
-                                pass_input, &pass_pos, pass);
-
-                        switch (ret) {
-                            case pass_auth_succ:
-                                exit_now = 1;
-                                break;
-
-                            case pass_auth_fail:
-                                foreach_screen
-                                    lock_screen_error(c, locks[i].screen,
-                                        locks[i].lock_window);
-                                break;
-
-                            case pass_not_check:
-                                foreach_screen
-                                    lock_screen_input(c, locks[i].screen,
-                                        locks[i].lock_window, pass_pos);
-                                break;
-                        }
-                        break;
-
-                    default: break;
-                }
-#undef foreach_screen
-next_event:
-                xcb_flush(c);
-                free(event);
-                wtimer_rearm(idle_timer, 0, NULL);
+        // we got xcb events
+        int64_t woken = nev > 0? metrics_now(): 0;
+        for (i = 0; i < nev && !exit_now; i++) {
+            d = evs[i].data.ptr;
+            if (handle_display_events(d, pass, woken))
+                exit_now = unlocked = 1;
+
+            if (xcb_connection_has_error(d->conn)) {
+                // our windows and grabs are gone with it, even if the
+                // server is not. The supervisor covers again whatever
+                // display is still there.
+                fprintf(stderr, "lost connection to %s, maybe X crashed\n",
+                        d->name? d->name: "$DISPLAY");
+                exit_now = 1;
+                unlocked = 0;
             }
         }
+        if (nev > 0) wtimer_rearm(idle_timer, 0, NULL);
+        alloc_metric(METRIC_ALLOC_LOOP, allocs);
     }
 
+    render_stop(render);
     free(tl);
     free(idle_timer);
+    free(evs);
+    close(epoll_fd);
     // make sure this area of memory is wipped out
-    clear_memory(pass_input, MAX_PASSLEN);
-    free(pass_input);
-    xcb_key_symbols_free(ksyms);
+    clear_memory(pass_area, nd * MAX_PASSLEN);
+    free(pass_area);
+    foreach_display(d) {
+        free(d->pass_wrong_timer);
+        xcb_key_symbols_free(d->ksyms);
+    }
+    return unlocked;
 }
-